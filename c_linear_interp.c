@@ -1,28 +1,65 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
 
 // code is only declaration or modification expressions (variables and constants only, arrays, &*)
 
-#define MAX_VARS_PER_STATEMENT 16
-#define ID_BUFF_SIZE 64
-#define STR_CONST_BUFF_SIZE 64
-#define PARSER_LINE_BUFFER 1024
+#define KEYWORD_HASH_SIZE 32
+#define INPUT_BLOCK_SIZE (1 << 16)
+#define STREAM_MAX_VARS (1 << 20)
+#define BATCH_START_CAP 64
+#define BATCH_CHUNK 4
+#define BATCH_WINDOW 4096
+#define PARAMS_START_CAP 64
+#define ARENA_CHUNK_SIZE (1 << 16)
+#define ARENA_ALIGN sizeof(max_align_t)
+#define SYMBOL_TABLE_START_CAP 64
+#define MEM_REGION_INDEX_START_CAP 64
+#define SANDBOX_MEM_SIZE (1ull << 32)
+#define SANDBOX_NULL_SIZE 16
+#define SANDBOX_KEEP_SIZE (1 << 20)
+#define VAR_SLAB_SIZE (1 << 16)
+#define VAR_SLABS_START_CAP 4
+#define STATEMENTS_START_CAP 64
+#define EXPR_POOL_MAX_NODES (1u << 27)
+#define EXPR_POOL_MAX_ITEMS (1u << 26)
+#define EXPR_POOL_KEEP_SIZE (1 << 20)
+#define PENDING_ITEMS_START_CAP 16
+#define DECL_FIELDS_START_CAP 16
+#define TOKENS_START_CAP 64
+#define DELIMS_START_CAP 1024
+#define PARSE_PART_MIN_SIZE (1 << 18)
 
 #define ARRAY_GROW_FACTOR 3 / 2
-#define EXPRESSION_STACK_START_CAP 16
-#define OPERATOR_STACK_START_CAP 16
 
 #define SINGLE_QUOTE 0x27
 
+// workers of parallel batch redirect output of their programs to own buffers
+#define OUT_STREAM (outStream != NULL ? outStream : stdout)
+#define ERR_STREAM (errStream != NULL ? errStream : stderr)
+
 #define SUCCESS 0
 #define ERROR 1
 #define MALLOC_ERROR 2
 
-#define error(args...) { fprintf(stderr, "ERROR in %s:%d: ", __FILE__, __LINE__); fprintf(stderr, args); fprintf(stderr, "\n"); }
+#define error(args...) { fprintf(ERR_STREAM, "ERROR in %s:%d: ", __FILE__, __LINE__); fprintf(ERR_STREAM, args); fprintf(ERR_STREAM, "\n"); }
+#define outPrintf(args...) fprintf(OUT_STREAM, args)
 #define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
 
 //#define malloc(s) (rand() % 43 == 0 ? NULL : malloc(s))
 //#define calloc(n, m) (rand() % 43 == 0 ? NULL : calloc(n, m))
@@ -35,6 +72,10 @@ typedef long long longlong;
 typedef unsigned long long ulonglong;
 typedef size_t size;
 
+// NULL - standard streams
+__thread FILE* outStream;
+__thread FILE* errStream;
+
 typedef enum {
     TK_END,
     TK_PRINT,
@@ -56,18 +97,9 @@ typedef enum {
     TK_LR_LR, TK_GR_GR,
     TK_PLUS_PLUS, TK_MINUS_MINUS,
     TK_EX_POINT, TK_TILDE,
-} TokenType;
-
-typedef struct {
-    TokenType type;
-    union {
-        char id[ID_BUFF_SIZE];
-        char str[STR_CONST_BUFF_SIZE];
 
-        double fVal;
-        longlong iVal;
-    };
-} Token;
+    TK_UNKNOWN, // char which starts no token
+} TokenType;
 
 typedef enum {
     PT_VOID,
@@ -81,6 +113,18 @@ typedef enum {
     _PT_END,
 } PrimitiveType;
 
+// text of token points into the source, it is not terminated
+typedef struct {
+    const char* text;
+    union {
+        double fVal;
+        longlong iVal;
+    };
+    uint len;
+    TokenType type : 16;
+    PrimitiveType constType : 16; // of number constant, set by its suffix
+} Token;
+
 typedef struct {
     PrimitiveType pt;
     uint pLevel;
@@ -117,25 +161,19 @@ typedef struct {
     uint isLeftAssoc: 1;
 } OpPriority;
 
-typedef struct {
-    int op;
-    OpPriority pr;
-
-    union {
-        Type castType;
-    };
-} MathToken;
-
 typedef enum {
     ST_VARIABLE_DECLARATION, ST_EXPRESSION, ST_PRINT,
 } StatementType;
 
 typedef struct Expression Expression;
 
-typedef struct ExpressionList {
-    Expression* expr;
-    struct ExpressionList* next;
-} ExpressionList;
+typedef uint ExprId; // index of node in ExprPool, 0 - no expression
+
+// list of expressions is a range of ExprPool items
+typedef struct {
+    uint first;
+    uint count;
+} ExprRange;
 
 typedef enum {
     EXPR_ASSIGNMENT,
@@ -145,6 +183,7 @@ typedef enum {
     EXPR_VARIABLE,
     EXPR_VALUE,
     EXPR_COMMA,
+    EXPR_COMPILED,
 } ExpressionType;
 
 typedef struct {
@@ -169,37 +208,49 @@ typedef struct {
 } ValueExpression;
 
 typedef struct {
-    char name[ID_BUFF_SIZE];
+    int slot;
 } VariableExpression;
 
 typedef struct {
     AssignmentOperatorType op;
-    Expression* expr1;
-    Expression* expr2;
+    ExprId expr1;
+    ExprId expr2;
 } AssignmentExpression;
 
 typedef struct {
     Type type;
-    Expression* expr;
+    ExprId expr;
+    int isImplicit; // conversion of operand inserted by resolveStatement
 } CastExpression;
 
 typedef struct {
     UnaryOperatorType op;
-    Expression* expr;
+    ExprId expr;
 } UnaryExpression;
 
 typedef struct {
     BinaryOperatorType op;
-    Expression* expr1;
-    Expression* expr2;
+    ExprId expr1;
+    ExprId expr2;
+    int factor; // of pointer arithmetic, set by resolveStatement
 } BinaryExpression;
 
 typedef struct {
-    ExpressionList* exprs;
+    ExprRange exprs;
 } CommaExpression;
 
+typedef struct VmCode VmCode;
+typedef struct ParamLanes ParamLanes;
+
+// source is kept for evaluation when compiled code fails
+typedef struct {
+    VmCode* code;
+    ExprId source;
+} CompiledExpression;
+
 struct Expression {
     ExpressionType type;
+    Type valueType; // set by resolveStatement, void - not known before running
     union {
         AssignmentExpression ae;
         CastExpression ce;
@@ -208,19 +259,39 @@ struct Expression {
         VariableExpression ve;
         ValueExpression vle;
         CommaExpression cme;
+        CompiledExpression cpe;
     };
 };
 
+// nodes and list items are reserved in mappings on the first allocation, so they never move
+// while the program grows and pointers to nodes stay valid. Node 0 is not used
+typedef struct {
+    Expression* nodes;
+    uint nodeCount;
+    ExprId* items;
+    uint itemCount;
+
+    // items of lists being parsed, nested list is on the top
+    ExprId* pending;
+    uint pendingCount;
+    uint pendingCapacity;
+} ExprPool;
+
+#define exprAt(pool, id) (&(pool)->nodes[id])
+#define exprId(pool, expr) ((ExprId) ((expr) - (pool)->nodes))
+#define exprItem(pool, range, i) ((pool)->items[(range).first + (i)])
+
 typedef struct { 
-    char name[ID_BUFF_SIZE]; 
+    int slot;
     int pLevel;
     int isArray;
     union {
-        Expression* expr; 
+        ExprId expr;
         struct {
             int arraySize;
-            ExpressionList* exprList;
-            void* arrDataPtr;
+            ExprRange inits;
+            // inits casted to the element type and packed, NULL - inits are evaluated
+            void* values;
         };
     };
 } VarDeclField;
@@ -228,22 +299,23 @@ typedef struct {
 typedef struct {
     PrimitiveType vType;
     int vAmount;
-
-    VarDeclField variables[MAX_VARS_PER_STATEMENT];
-
+    VarDeclField* variables; // in arena
 } VarDeclStatement;
 
 typedef struct {
-    Expression* expr;
+    ExprId expr;
 } ExpressionStatement;
 
 typedef struct {
-    Expression* expr;
+    ExprId expr;
 } PrintStatement;
 
+// text of statement is a span of input, it is printed from there.
+// Offset is counted from the beginning of input, leading spaces are not in the span
 typedef struct {
     StatementType type;
-    char* codeLine;
+    uint codeLen;
+    size_t codeOffset;
     union {
         VarDeclStatement vs;
         ExpressionStatement es;
@@ -251,41 +323,150 @@ typedef struct {
     };
 } Statement;
 
-typedef struct StatementList {
-    Statement st;
-    struct StatementList* next;
-} StatementList;
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaChunk;
 
 typedef struct {
-    char name[ID_BUFF_SIZE];
+    ArenaChunk* chunks;
+} Arena;
+
+// names of variables, slot is index in names
+typedef struct {
+    Arena strings;
+    char** names;
+    int count;
+    int capacity;
+
+    int* hash; // slot + 1, 0 - empty
+    int hashCapacity;
+} SymbolTable;
+
+typedef struct {
+    Arena arena;
+    ExprPool exprs;
+    SymbolTable symbols;
+    Statement* statements;
+    int statementCount;
+    int statementCapacity;
+
+    // fields of declaration being parsed, they are copied to arena when it ends
+    VarDeclField* declFields;
+    int declFieldCapacity;
+
+    // statement being parsed is lexed here before parsing, it ends with TK_END
+    Token* tokens;
+    int tokenCapacity;
+
+    // token of the first parser error of statement and its input offset when parsing fails
+    const char* errorToken;
+    size_t errorOffset;
+
+    // mapped image which holds statements of loaded program, NULL - program is parsed
+    char* image;
+    size_t imageSize;
+} Program;
+
+// value of width bytes is stored at data: in slab of usual context, in memory of sandboxed one.
+// Value of v is the initial one
+typedef struct {
     ValueExpression v;
+    int isDefined;
+    int width;
+    void* data;
 } CtxVariable;
 
-typedef struct CtxVarList {
-    CtxVariable var;
-    struct CtxVarList* next;
-} CtxVarList;
-
 typedef struct {
     void* regStart;
     size_t regSize;
 } CtxMemoryRegion;
 
-typedef struct CtxMemoryRegionList {
+// treap node, ordered by regStart
+typedef struct {
     CtxMemoryRegion region;
-    struct CtxMemoryRegionList* next;
-} CtxMemoryRegionList;
+    uint priority;
+    int left, right;
+} CtxMemoryRegionNode;
 
+// regions never overlap, so only the nearest region starting before address can hold it
 typedef struct {
-    CtxVarList* varList;
-    CtxMemoryRegionList* memRegList;
+    CtxMemoryRegionNode* nodes;
+    int count;
+    int capacity;
+    int root;
+    int lastHit;
+    uint seed;
+} CtxMemoryRegionIndex;
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t pos;
+    size_t cap;
+    int isMapped;
+
+    // stream is read by blocks when statements are requested, consumed data is dropped
+    int isStream;
+    int isEof;
+    int fd;
+    int error; // SUCCESS, ERROR, MALLOC_ERROR
+
+    // offsets of all ';' of input which is read at once, NULL - statements are searched
+    size_t* delims;
+    size_t delimCount;
+    size_t nextDelim;
+
+    // offsets of input count data dropped from stream, positions are counted from origin.
+    // Data from origin is kept when keepsOrigin, else lines of dropped data are counted
+    size_t dropped;
+    size_t origin;
+    int keepsOrigin;
+    uint droppedLines;
+    size_t droppedLineStart;
+} InputBuffer;
+
+typedef struct {
+    CtxVariable* vars;
+    int varCount;
+    int isVarsMapped;
+    const SymbolTable* symbols;
+    const ExprPool* exprs;
+    CtxMemoryRegionIndex memRegions;
     int hasEvaluationError;
+
+    // data of declared arrays, it lives as long as variables
+    void** arrays;
+    int arrayCount;
+    int arrayCapacity;
+
+    // slabs of VAR_SLAB_SIZE which hold values of scalar variables packed by natural alignment.
+    // Slab never moves and is one memory region, the region grows with slabUsed
+    char** slabs;
+    int slabCount;
+    int slabCapacity;
+    int slabIndex; // slab which is filled, -1 - none
+    size_t slabUsed;
+    int slabRegion;
+
+    // initial values of variables for the run by slot, they replace initializers of declarations.
+    // Void value - variable is not bound, NULL - no parameters
+    ValueExpression* params;
+    // values of VM_LANES runs which are executed at once, NULL - runs are executed one by one
+    ParamLanes* lanes;
+
+    // linear memory of sandboxed context which holds values of variables and arrays, NULL - not
+    // sandboxed. Pointers of the program are offsets in it, offsets below SANDBOX_NULL_SIZE are not used
+    char* mem;
+    size_t memUsed;
 } Context;
 
 void printValueExpression(ValueExpression* ve) {
-    printf("--print-- Value: ");
+    outPrintf("--print-- Value: ");
 
-    #define CASE(T, t) case PT_##T: printf("(" #t); break;
+    #define CASE(T, t) case PT_##T: outPrintf("(" #t); break;
     switch (ve->type.pt) {
         CASE(VOID, void)
         CASE(CHAR, char)
@@ -306,56 +487,56 @@ void printValueExpression(ValueExpression* ve) {
     }
 
     for (int i = 0; i < ve->type.pLevel; i++) {
-        printf("*");
+        outPrintf("*");
     }
 
-    printf(") ");
+    outPrintf(") ");
     #undef CASE
 
     if (ve->type.pLevel != 0) {
-        printf("%lx\n", ve->st);
+        outPrintf("%lx\n", ve->st);
         return;
     }
     switch (ve->type.pt)
     {
         case PT_VOID:
-            printf("\n");
+            outPrintf("\n");
             return;
         case PT_CHAR:
-            printf("%c\n", ve->c);
+            outPrintf("%c\n", ve->c);
             return;
         case PT_UCHAR:
-            printf("%u\n", (unsigned) ve->uc);
+            outPrintf("%u\n", (unsigned) ve->uc);
             return;
         case PT_SHORT:
-            printf("%d\n", (int) ve->s);
+            outPrintf("%d\n", (int) ve->s);
             return;
         case PT_USHORT:
-            printf("%u\n", (unsigned) ve->us);
+            outPrintf("%u\n", (unsigned) ve->us);
             return;
         case PT_INT:
-            printf("%d\n", ve->i);
+            outPrintf("%d\n", ve->i);
             return;
         case PT_UINT:
-            printf("%u\n", ve->ui);
+            outPrintf("%u\n", ve->ui);
             return;
         case PT_LONG:
-            printf("%ld\n", ve->l);
+            outPrintf("%ld\n", ve->l);
             return;
         case PT_ULONG:
-            printf("%lu\n", ve->ul);
+            outPrintf("%lu\n", ve->ul);
             return;
         case PT_LONGLONG:
-            printf("%lld\n", ve->ll);
+            outPrintf("%lld\n", ve->ll);
             return;
         case PT_ULONGLONG:
-            printf("%llu\n", ve->ull);
+            outPrintf("%llu\n", ve->ull);
             return;
         case PT_FLOAT:
-            printf("%f\n", ve->f);
+            outPrintf("%f\n", ve->f);
             return;
         case PT_DOUBLE:
-            printf("%lf\n", ve->d);
+            outPrintf("%lf\n", ve->d);
             return;
         
         default:
@@ -364,15 +545,362 @@ void printValueExpression(ValueExpression* ve) {
     }
 }
 
-char* fgetsd(char* buff, int buffSize, FILE* f, char delim) {
-    char c;
-    int pos = 0;
-    while (pos < buffSize - 1 && fscanf(f, "%c", &c) != 0 && c != delim) {
-        buff[pos++] = c;
+// character classes of the lexer
+#define CC_SPACE 1
+#define CC_ID 2
+#define CC_DIGIT 4
+#define CC_XDIGIT 8
+
+#define isCharClass(c, cc) (charClasses[(uchar) (c)] & (cc))
+
+const uchar charClasses[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['a' ... 'f'] = CC_ID | CC_XDIGIT, ['g' ... 'z'] = CC_ID,
+    ['A' ... 'F'] = CC_ID | CC_XDIGIT, ['G' ... 'Z'] = CC_ID,
+    ['_'] = CC_ID,
+    ['0' ... '9'] = CC_DIGIT | CC_XDIGIT,
+};
+
+// scan kernels: the best one for the CPU is selected by selectScanKernels at start
+typedef struct {
+    // offsets of ';' in s[0, n) are written to `to` with base added, `to` has place for n offsets
+    // Ret: amount of offsets
+    size_t (*scanDelimiters)(const char* s, size_t n, size_t base, size_t* to);
+    // Ret: first char which is not space, terminating 0 stops it
+    char* (*skipSpaces)(char* s);
+} ScanKernels;
+
+size_t scanDelimitersScalar(const char* s, size_t n, size_t base, size_t* to) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == ';') to[count++] = base + i;
+    }
+    return count;
+}
+
+char* skipSpacesScalar(char* s) {
+    while (isCharClass(*s, CC_SPACE)) s++;
+    return s;
+}
+
+#ifdef HAS_X86_KERNELS
+
+// bits of bytes which are equal to ';'
+#define DEFINE_scanDelimiters(NAME, TARGET, VEC, WIDTH, SET1, LOADU, CMPEQ, MOVEMASK) \
+__attribute__((target(TARGET))) \
+size_t scanDelimiters##NAME(const char* s, size_t n, size_t base, size_t* to) { \
+    const VEC semicolon = SET1(';'); \
+    size_t count = 0, i = 0; \
+    for (; i + WIDTH <= n; i += WIDTH) { \
+        uint mask = MOVEMASK(CMPEQ(LOADU((const VEC*) (s + i)), semicolon)); \
+        while (mask != 0) { \
+            to[count++] = base + i + __builtin_ctz(mask); \
+            mask &= mask - 1; \
+        } \
+    } \
+    return count + scanDelimitersScalar(s + i, n - i, base + i, to + count); \
+}
+
+// bits of bytes which are not spaces: ' ' or '\t'..'\r'. Loads are aligned, so they don't cross
+// a page and may read the bytes after the terminating 0, which are ignored
+#define DEFINE_skipSpaces(NAME, TARGET, VEC, WIDTH, SET1, LOAD, CMPEQ, SUB, MIN, OR, MOVEMASK) \
+__attribute__((target(TARGET), no_sanitize_address)) \
+uint nonSpaceMask##NAME(const char* block) { \
+    VEC v = LOAD((const VEC*) block); \
+    VEC ctrl = SUB(v, SET1('\t')); \
+    VEC isSpace = OR(CMPEQ(v, SET1(' ')), CMPEQ(MIN(ctrl, SET1('\r' - '\t')), ctrl)); \
+    return ~(uint) MOVEMASK(isSpace) & (uint) ((1ull << WIDTH) - 1); \
+} \
+__attribute__((target(TARGET))) \
+char* skipSpaces##NAME(char* s) { \
+    const char* block = (const char*) ((size_t) s & ~(size_t) (WIDTH - 1)); \
+    uint mask = nonSpaceMask##NAME(block) >> (s - block); \
+    if (mask != 0) return s + __builtin_ctz(mask); \
+    for (;;) { \
+        block += WIDTH; \
+        mask = nonSpaceMask##NAME(block); \
+        if (mask != 0) return (char*) block + __builtin_ctz(mask); \
+    } \
+}
+
+DEFINE_scanDelimiters(Sse2, "sse2", __m128i, 16, _mm_set1_epi8, _mm_loadu_si128, _mm_cmpeq_epi8, _mm_movemask_epi8)
+DEFINE_scanDelimiters(Avx2, "avx2", __m256i, 32, _mm256_set1_epi8, _mm256_loadu_si256, _mm256_cmpeq_epi8,
+                      _mm256_movemask_epi8)
+DEFINE_skipSpaces(Sse2, "sse2", __m128i, 16, _mm_set1_epi8, _mm_load_si128, _mm_cmpeq_epi8, _mm_sub_epi8,
+                  _mm_min_epu8, _mm_or_si128, _mm_movemask_epi8)
+DEFINE_skipSpaces(Avx2, "avx2", __m256i, 32, _mm256_set1_epi8, _mm256_load_si256, _mm256_cmpeq_epi8,
+                  _mm256_sub_epi8, _mm256_min_epu8, _mm256_or_si256, _mm256_movemask_epi8)
+
+#endif
+
+ScanKernels scanKernels = {scanDelimitersScalar, skipSpacesScalar};
+
+// must be called before threads start
+void selectScanKernels() {
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanKernels.scanDelimiters = scanDelimitersAvx2;
+        scanKernels.skipSpaces = skipSpacesAvx2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        scanKernels.scanDelimiters = scanDelimitersSse2;
+        scanKernels.skipSpaces = skipSpacesSse2;
+    }
+#endif
+}
+
+// spaces and `//` comments are skipped, comment ends with the line or the statement
+char* strskp(char* s) {
+    for (;;) {
+        // single spaces between tokens are usual, longer runs go to the kernel
+        if (isCharClass(*s, CC_SPACE)) {
+            s++;
+            if (isCharClass(*s, CC_SPACE)) s = scanKernels.skipSpaces(s);
+        }
+        if (s[0] != '/' || s[1] != '/') return s;
+        while (*s != 0 && *s != '\n' && *s != ';') s++;
+    }
+}
+
+void inputClose(InputBuffer* in) {
+    if (in->isMapped) munmap(in->data, in->size);
+    else free(in->data);
+    free(in->delims);
+    in->delims = NULL;
+    in->delimCount = in->nextDelim = 0;
+    in->data = NULL;
+    in->size = in->pos = in->cap = 0;
+    in->isMapped = 0;
+    in->isStream = 0;
+}
+
+// offsets of all statement ends are found in one pass over the input,
+// space for them is reserved by blocks, so untouched part of it takes no memory
+// Ret: SUCCESS, MALLOC_ERROR
+int inputIndexDelimiters(InputBuffer* in) {
+    size_t cap = 0;
+
+    for (size_t pos = 0; pos < in->size; pos += INPUT_BLOCK_SIZE) {
+        size_t n = min(in->size - pos, INPUT_BLOCK_SIZE);
+
+        if (cap - in->delimCount < n) {
+            size_t newCap = max(cap * 2, in->delimCount + n);
+            size_t* newDelims = (size_t*) realloc(in->delims, newCap * sizeof(size_t));
+            if (newDelims == NULL) {
+                inputClose(in);
+                return MALLOC_ERROR;
+            }
+            in->delims = newDelims;
+            cap = newCap;
+        }
+        in->delimCount += scanKernels.scanDelimiters(in->data + pos, n, pos, in->delims + in->delimCount);
+    }
+    return SUCCESS;
+}
+
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+// regular files are mapped, everything else is read by big blocks: the whole input at once
+// or, for stream, when the next statement is not in buffer yet;
+// data is always followed by 0, so the last statement is terminated
+int inputOpen(InputBuffer* in, FILE* f, int isStream) {
+    struct stat sb;
+    int fd = fileno(f);
+
+    in->data = NULL;
+    in->size = in->pos = in->cap = 0;
+    in->isMapped = 0;
+    in->isStream = 0;
+    in->isEof = 0;
+    in->fd = fd;
+    in->error = SUCCESS;
+    in->delims = NULL;
+    in->delimCount = in->nextDelim = 0;
+    in->dropped = in->origin = in->droppedLineStart = 0;
+    in->keepsOrigin = 0;
+    in->droppedLines = 0;
+
+    if (fd >= 0 && fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0 &&
+        lseek(fd, 0, SEEK_CUR) == 0 && sb.st_size % sysconf(_SC_PAGESIZE) != 0) {
+        // tail of the last page is zero-filled by the kernel
+        void* p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            in->data = (char*) p;
+            in->size = in->cap = sb.st_size;
+            in->isMapped = 1;
+            return inputIndexDelimiters(in);
+        }
+    }
+
+    if (isStream) {
+        in->data = (char*) malloc(INPUT_BLOCK_SIZE + 1);
+        if (in->data == NULL) return MALLOC_ERROR;
+        in->data[0] = 0;
+        in->cap = INPUT_BLOCK_SIZE + 1;
+        in->isStream = 1;
+        return SUCCESS;
+    }
+
+    for (;;) {
+        size_t got;
+
+        if (in->cap - in->size < INPUT_BLOCK_SIZE + 1) {
+            size_t newCap = in->cap ? in->cap * 2 : INPUT_BLOCK_SIZE + 1;
+            char* newData = (char*) realloc(in->data, newCap);
+            if (newData == NULL) {
+                inputClose(in);
+                return MALLOC_ERROR;
+            }
+            in->data = newData;
+            in->cap = newCap;
+        }
+
+        got = fread(in->data + in->size, 1, INPUT_BLOCK_SIZE, f);
+        in->size += got;
+        if (got < INPUT_BLOCK_SIZE) break;
+    }
+    in->data[in->size] = 0;
+
+    if (ferror(f)) {
+        inputClose(in);
+        return ERROR;
+    }
+    return inputIndexDelimiters(in);
+}
+
+// consumed data is moved out, then the next block of stream is appended
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int inputReadBlock(InputBuffer* in) {
+    size_t drop = in->keepsOrigin ? min(in->pos, in->origin - in->dropped) : in->pos;
+    char* p = in->data + (max(in->origin, in->dropped) - in->dropped);
+    ssize_t got;
+
+    for (; p < in->data + drop && (p = (char*) memchr(p, '\n', in->data + drop - p)) != NULL; p++) {
+        in->droppedLines++;
+        in->droppedLineStart = p - in->data + in->dropped + 1;
+    }
+
+    memmove(in->data, in->data + drop, in->size - drop);
+    in->size -= drop;
+    in->pos -= drop;
+    in->dropped += drop;
+
+    // statement is longer than buffer
+    if (in->cap - in->size < INPUT_BLOCK_SIZE + 1) {
+        size_t newCap = in->cap * 2;
+        char* newData = (char*) realloc(in->data, newCap);
+        if (newData == NULL) return MALLOC_ERROR;
+        in->data = newData;
+        in->cap = newCap;
+    }
+
+    do {
+        got = read(in->fd, in->data + in->size, INPUT_BLOCK_SIZE);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) return ERROR;
+
+    if (got == 0) in->isEof = 1;
+    in->size += got;
+    in->data[in->size] = 0;
+    return SUCCESS;
+}
+
+// Ret: NULL - no more input or in->error is set, statement beginning - success
+// statement is not copied, it ends with ';' or 0 at *len; for stream it is valid until the next call
+char* inputNextStatement(InputBuffer* in, size_t* len) {
+    char* begin,* end;
+
+    // pos never passes size, at size the input is over unless more of the stream is read
+    if (in->pos >= in->size && (!in->isStream || in->isEof)) return NULL;
+    if (in->delims != NULL) {
+        begin = in->data + in->pos;
+        while (in->nextDelim < in->delimCount && in->delims[in->nextDelim] < in->pos) in->nextDelim++;
+        end = in->nextDelim < in->delimCount ? in->data + in->delims[in->nextDelim] : NULL;
+    }
+    else {
+        for (;;) {
+            begin = in->data + in->pos;
+            end = (char*) memchr(begin, ';', in->size - in->pos);
+            if (end != NULL || !in->isStream || in->isEof) break;
+
+            if ((in->error = inputReadBlock(in)) != SUCCESS) return NULL;
+        }
+    }
+
+    if (in->pos >= in->size) return NULL;
+    if (end == NULL) end = in->data + in->size;
+
+    *len = end - begin;
+    in->pos = min((size_t) (end - in->data) + 1, in->size);
+    return begin;
+}
+
+// Ret: offset of input text
+size_t inputOffset(const InputBuffer* in, const char* text) {
+    return text - in->data + in->dropped;
+}
+
+// Ret: input text at offset, it must not be dropped
+const char* inputAt(const InputBuffer* in, size_t offset) {
+    return in->data + (offset - in->dropped);
+}
+
+// positions are counted from the current position, stream keeps data from it
+void inputSetOrigin(InputBuffer* in) {
+    in->origin = inputOffset(in, in->data + in->pos);
+    in->keepsOrigin = 1;
+    in->droppedLines = 0;
+    in->droppedLineStart = in->origin;
+}
+
+// line and column of offset, both are counted from 1
+void inputPosition(const InputBuffer* in, size_t offset, uint* line, uint* column) {
+    const char* p = inputAt(in, max(in->origin, in->dropped)),* end = inputAt(in, offset);
+    size_t lineStart = max(in->origin, in->droppedLineStart);
+
+    *line = in->droppedLines + 1;
+    for (; p < end && (p = (const char*) memchr(p, '\n', end - p)) != NULL; p++) {
+        (*line)++;
+        lineStart = inputOffset(in, p) + 1;
+    }
+    *column = offset - lineStart + 1;
+}
+
+// Ret: amount of statements of indexed input, text after the last ';' is a statement too
+size_t inputStatementCount(const InputBuffer* in) {
+    size_t tail = in->delimCount != 0 ? in->delims[in->delimCount - 1] + 1 : 0;
+    return in->delimCount + (tail < in->size);
+}
+
+// Ret: beginning of statement k of indexed input, its length is at *len
+char* inputStatementAt(const InputBuffer* in, size_t k, size_t* len) {
+    size_t begin = k != 0 ? in->delims[k - 1] + 1 : 0;
+    size_t end = k < in->delimCount ? in->delims[k] : in->size;
+
+    *len = end - begin;
+    return in->data + begin;
+}
+
+// Ret: 1 - only spaces and comments are left in input, 0 - there are statements
+int inputIsOver(InputBuffer* in) {
+    for (;;) {
+        char* s = strskp(in->data + in->pos);
+
+        in->pos = s - in->data;
+        if (in->pos < in->size) return 0;
+        if (!in->isStream || in->isEof) return 1;
+        if ((in->error = inputReadBlock(in)) != SUCCESS) return 1;
+    }
+}
+
+// statements are skipped up to the empty one which ends the program
+void inputSkipProgram(InputBuffer* in) {
+    char* statement;
+    size_t len;
+
+    while ((statement = inputNextStatement(in, &len)) != NULL) {
+        if (strskp(statement) == statement + len) return;
     }
-    buff[pos] = 0;
-    if (pos == 0) return NULL;
-    return buff;
 }
 
 void strncpy0(char* dest, const char* src, size_t n) {
@@ -606,12 +1134,8 @@ int tokenToBinaryOrAssignmentOperator(Token* tk) {
 }
 
 // skip all whitespaces
-char* strskp(char* s) {
-    while (isspace(*s)) s++;
-    return s;
-}
 
-#define evalError(args...) { ctx->hasEvaluationError = 1; printf("Evaluation error: "); printf(args); puts(""); }
+#define evalError(args...) { ctx->hasEvaluationError = 1; outPrintf("Evaluation error: "); outPrintf(args); outPrintf("\n"); }
 
 // Ret: 0 - error, not 0 - success
 int sizeOf(PrimitiveType t) {
@@ -641,231 +1165,673 @@ int getPointerOperationFactor(const Type* t) {
     return t->pLevel == 1 ? sizeOf(t->pt) : sizeof(size);
 }
 
+// bytes of value in memory
+int valueWidth(Type t) {
+    return t.pLevel != 0 ? (int) sizeof(size) : sizeOf(t.pt);
+}
+
 void initValueExpression(ValueExpression* v) {
     v->type.pLevel = 0;
     v->type.pt = PT_VOID;
     v->ull = 0;
 }
 
-CtxVariable* ctxGetVariable(const Context* ctx, const char* name) {
-    CtxVarList* l = ctx->varList;
-    for (; l != NULL; l = l->next) {
-        CtxVariable* v = &l->var;
-        if (!strcmp(v->name, name)) return v;
+CtxVariable* ctxGetVariable(const Context* ctx, int slot) {
+    CtxVariable* v = &ctx->vars[slot];
+    return v->isDefined ? v : NULL;
+}
+
+void initCtxMemRegIndex(CtxMemoryRegionIndex* idx) {
+    idx->nodes = NULL;
+    idx->count = idx->capacity = 0;
+    idx->root = idx->lastHit = -1;
+    idx->seed = 2463534242u;
+}
+
+void resetCtxMemRegIndex(CtxMemoryRegionIndex* idx) {
+    idx->count = 0;
+    idx->root = idx->lastHit = -1;
+}
+
+void freeCtxMemRegIndex(CtxMemoryRegionIndex* idx) {
+    free(idx->nodes);
+    initCtxMemRegIndex(idx);
+}
+
+void arenaInit(Arena* arena) {
+    arena->chunks = NULL;
+}
+
+// Ret: NULL - malloc error, zeroed memory - success
+void* arenaAlloc(Arena* arena, size_t n) {
+    ArenaChunk* chunk = arena->chunks;
+    void* p;
+
+    n = (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    if (chunk == NULL || chunk->size - chunk->used < n) {
+        size_t chunkSize = n > ARENA_CHUNK_SIZE ? n : ARENA_CHUNK_SIZE;
+        ArenaChunk* newChunk = (ArenaChunk*) malloc(sizeof(*newChunk) + chunkSize);
+        if (newChunk == NULL) return NULL;
+
+        newChunk->size = chunkSize;
+        newChunk->used = 0;
+
+        // keep filling current chunk if the new one is taken by a single big allocation
+        if (chunk != NULL && chunkSize != ARENA_CHUNK_SIZE) {
+            newChunk->next = chunk->next;
+            chunk->next = newChunk;
+        }
+        else {
+            newChunk->next = chunk;
+            arena->chunks = newChunk;
+        }
+        chunk = newChunk;
     }
-    return NULL;
+
+    p = (char*) chunk->data + chunk->used;
+    chunk->used += n;
+    memset(p, 0, n);
+    return p;
 }
 
-void freeCtxVarList(CtxVarList* l) {
-    if (l == NULL) return;
-    freeCtxVarList(l->next);
-    l->next = NULL;
-    free(l);
-}
-
-void ctxFreeVarList(Context* ctx) {
-    freeCtxVarList(ctx->varList);
-    ctx->varList = NULL;
-}
-
-void freeExpression(Expression* expr);
-
-#define DEFINE_STACK(N, T, FREE_CODE)                           \
-typedef struct {                                                \
-    T* arr;                                                     \
-    int size;                                                   \
-    int capacity;                                               \
-} Stack##N;                                                     \
-                                                                \
-/* Ret: MALLOC_ERROR, SUCCESS */                                \
-int stackInit##N(Stack##N* st, int cap) {                       \
-    T* arr = (T*) malloc(sizeof(*arr) * cap);                   \
-    if (arr == NULL) return MALLOC_ERROR;                       \
-    st->arr = arr;                                              \
-    st->capacity = cap;                                         \
-    st->size = 0;                                               \
-    return SUCCESS;                                             \
-}                                                               \
-                                                                \
-/* Ret: MALLOC_ERROR, SUCCESS */                                \
-int stackPush##N(Stack##N* st, T* t) {                          \
-    if (st->size == st->capacity) {                             \
-        T* newArr = (T*) realloc(                               \
-            st->arr,                                            \
-            sizeof(*newArr) * st->size * ARRAY_GROW_FACTOR      \
-        );                                                      \
-        if (newArr == NULL) return MALLOC_ERROR;                \
-        st->arr = newArr;                                       \
-    }                                                           \
-    st->arr[st->size++] = *t;                                   \
-    return SUCCESS;                                             \
-}                                                               \
-                                                                \
-/* Ret: MALLOC_ERROR, SUCCESS */                                \
-int stackPop##N(Stack##N* st, T* to) {                          \
-    if (st->size <= 0) return ERROR;                            \
-    if (to == NULL) {                                           \
-        T val;                                                  \
-        val = st->arr[--st->size];                              \
-        FREE_CODE;                                              \
-        return ERROR;                                           \
-    }                                                           \
-    *to = st->arr[--st->size];                                  \
-    return SUCCESS;                                             \
-}                                                               \
-                                                                \
-/* Ret: ERROR, SUCCESS */                                       \
-int stackTop##N(Stack##N* st, T* to) {                          \
-    if (st->size <= 0) return ERROR;                            \
-    *to = st->arr[st->size - 1];                                \
-    return SUCCESS;                                             \
-}                                                               \
-                                                                \
-void freeStack##N(Stack##N* st) {                               \
-    T val;                                                      \
-    while (stackPop##N(st, &val) == SUCCESS) FREE_CODE;         \
-    free(st->arr);                                              \
-    st->arr = NULL;                                             \
-    st->size = st->capacity = 0;                                \
-}
-
-DEFINE_STACK(MathToken, MathToken, {})
-DEFINE_STACK(Expression, Expression*, { freeExpression(val); })
-
-#undef DEFINE_STACK
-
-void freeExpressionList(ExpressionList* l) {
-    if (l == NULL) return;
-    freeExpressionList(l->next);
-
-    freeExpression(l->expr);
-    l->expr = NULL;
-    free(l);
-}
-
-void freeStatementContent(Statement* st) {
-    free(st->codeLine);
-    switch (st->type)
-    {
-        case ST_EXPRESSION:
-            freeExpression(st->es.expr);
-            st->es.expr = NULL;
-            break;
-        case ST_VARIABLE_DECLARATION:
-            for (int i = 0; i < st->vs.vAmount; i++)
-            {
-                VarDeclField* f = &st->vs.variables[i];
-                
-                if (f->isArray) {
-                    freeExpressionList(f->exprList);
-                    f->exprList = NULL;
-                    free(f->arrDataPtr);
-                    f->arrDataPtr = NULL;
-                }
-                else {
-                    if (f->expr != NULL) {
-                        freeExpression(f->expr);
-                        f->expr = NULL;
-                    }
-                }
-            }
-            break;
-        case ST_PRINT:
-            freeExpression(st->ps.expr);
-            st->ps.expr = NULL;
-            break;
-        default:
-            error("Bad statement type %d", st->type);
-            break;
+void freeArena(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
+
+// all allocations are dropped, the current chunk is kept for the next ones
+void arenaReset(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+
+    if (chunk == NULL) return;
+    if (chunk->size != ARENA_CHUNK_SIZE) {
+        freeArena(arena);
+        return;
+    }
+
+    while (chunk->next != NULL) {
+        ArenaChunk* next = chunk->next;
+        chunk->next = next->next;
+        free(next);
     }
+    chunk->used = 0;
 }
 
-void freeStatementList(StatementList* node) {
-    if (node == NULL) return;
-    freeStatementList(node->next);
-    node->next = NULL;
+void initSymbolTable(SymbolTable* t) {
+    arenaInit(&t->strings);
+    t->names = NULL;
+    t->count = t->capacity = 0;
+    t->hash = NULL;
+    t->hashCapacity = 0;
+}
 
-    freeStatementContent(&node->st);
-    free(node);
+// names are dropped, storage is kept for the next program
+void resetSymbolTable(SymbolTable* t) {
+    arenaReset(&t->strings);
+    t->count = 0;
+    if (t->hash != NULL) memset(t->hash, 0, t->hashCapacity * sizeof(*t->hash));
 }
 
-void freeCtxMemRegList(CtxMemoryRegionList* node) {
-    if (node == NULL) return;
-    freeCtxMemRegList(node->next);
-    node->next = NULL;
+void freeSymbolTable(SymbolTable* t) {
+    freeArena(&t->strings);
+    free(t->names);
+    free(t->hash);
+    initSymbolTable(t);
+}
 
-    free(node);
+uint hashName(const char* name, size_t len) {
+    uint h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uchar) name[i]) * 16777619u;
+    return h;
 }
 
-Expression* allocExpression(ExpressionType t) {
-    Expression* expr = (Expression*) malloc(sizeof(*expr));
-    if (expr == NULL) return NULL;
-    expr->type = t;
-    return expr;
+// Ret: MALLOC_ERROR, SUCCESS
+int symbolTableRehash(SymbolTable* t, int newCapacity) {
+    int* newHash = (int*) calloc(newCapacity, sizeof(*newHash));
+    if (newHash == NULL) return MALLOC_ERROR;
+
+    for (int slot = 0; slot < t->count; slot++) {
+        uint i = hashName(t->names[slot], strlen(t->names[slot])) & (newCapacity - 1);
+        while (newHash[i] != 0) i = (i + 1) & (newCapacity - 1);
+        newHash[i] = slot + 1;
+    }
+
+    free(t->hash);
+    t->hash = newHash;
+    t->hashCapacity = newCapacity;
+    return SUCCESS;
 }
 
-StatementList* allocStatementList() {
-    return (StatementList*) calloc(1, sizeof(StatementList));
+// name is not terminated, it has len chars
+// Ret: -1 - no such name, slot of the name - success
+int symbolLookup(const SymbolTable* t, const char* name, size_t len) {
+    if (t->hashCapacity == 0) return -1;
+
+    for (uint i = hashName(name, len) & (t->hashCapacity - 1); t->hash[i] != 0; i = (i + 1) & (t->hashCapacity - 1)) {
+        int slot = t->hash[i] - 1;
+        if (!strncmp(t->names[slot], name, len) && t->names[slot][len] == 0) return slot;
+    }
+    return -1;
 }
 
-// Ret: MALLOC_ERROR, ERROR - variable already defined, SUCCESS
-int ctxRegisterVariable(Context* ctx, CtxVariable v, CtxVariable** toRetPtr) {
-    if (ctxGetVariable(ctx, v.name) != NULL) return ERROR;
+// name is not terminated, it has len chars
+// Ret: -1 - malloc error, slot of the name - success
+int symbolIntern(SymbolTable* t, const char* name, size_t len) {
+    uint i;
+    int slot = symbolLookup(t, name, len);
+    char* copy;
 
-    CtxVarList* newNode = (CtxVarList*) malloc(sizeof(*newNode));
-    if (newNode == NULL) {
-        return MALLOC_ERROR;
+    if (slot != -1) return slot;
+
+    if ((t->count + 1) * 2 > t->hashCapacity) {
+        if (symbolTableRehash(t, t->hashCapacity ? t->hashCapacity * 2 : SYMBOL_TABLE_START_CAP) != SUCCESS)
+            return -1;
+    }
+    if (t->count == t->capacity) {
+        int newCap = t->capacity ? t->capacity * 2 : SYMBOL_TABLE_START_CAP;
+        char** newNames = (char**) realloc(t->names, newCap * sizeof(*newNames));
+        if (newNames == NULL) return -1;
+        t->names = newNames;
+        t->capacity = newCap;
     }
-    newNode->var = v;
-    newNode->next = ctx->varList;
-    ctx->varList = newNode;
 
-    if (toRetPtr != NULL)
-        *toRetPtr = &newNode->var;
+    copy = (char*) arenaAlloc(&t->strings, len + 1);
+    if (copy == NULL) return -1;
+    memcpy(copy, name, len);
+    copy[len] = 0;
 
-    return SUCCESS;
+    slot = t->count++;
+    t->names[slot] = copy;
+
+    i = hashName(name, len) & (t->hashCapacity - 1);
+    while (t->hash[i] != 0) i = (i + 1) & (t->hashCapacity - 1);
+    t->hash[i] = slot + 1;
+
+    return slot;
 }
 
-// Ret: MALLOC_ERROR, SUCCESS
-int ctxAddMemoryRegion(Context* ctx, void* start, size_t size) {
-    CtxMemoryRegionList* newNode = (CtxMemoryRegionList*) malloc(sizeof(*newNode));
-    if (newNode == NULL) {
+// Ret: SUCCESS, MALLOC_ERROR
+int exprPoolMap(ExprPool* pool) {
+    void* nodes,* items;
+
+    if (pool->nodes != NULL) return SUCCESS;
+
+    nodes = mmap(NULL, EXPR_POOL_MAX_NODES * sizeof(Expression), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    items = mmap(NULL, EXPR_POOL_MAX_ITEMS * sizeof(ExprId), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (nodes == MAP_FAILED || items == MAP_FAILED) {
+        if (nodes != MAP_FAILED) munmap(nodes, EXPR_POOL_MAX_NODES * sizeof(Expression));
+        if (items != MAP_FAILED) munmap(items, EXPR_POOL_MAX_ITEMS * sizeof(ExprId));
         return MALLOC_ERROR;
     }
+    pool->nodes = (Expression*) nodes;
+    pool->items = (ExprId*) items;
+    pool->nodeCount = 1;
+    pool->itemCount = 0;
+    return SUCCESS;
+}
+
+// Ret: NULL - malloc error or pool is full, new node - success
+Expression* allocExpression(ExprPool* pool, ExpressionType t) {
+    Expression* expr;
+
+    if (exprPoolMap(pool) != SUCCESS) return NULL;
+    if (pool->nodeCount == EXPR_POOL_MAX_NODES) return NULL;
+
+    expr = &pool->nodes[pool->nodeCount++];
+    memset(expr, 0, sizeof(*expr));
+    expr->type = t;
+    expr->valueType.pt = PT_VOID;
+    expr->valueType.pLevel = 0;
+    return expr;
+}
+
+// item is added to the list being parsed, list begins at pendingCount
+// Ret: SUCCESS, MALLOC_ERROR
+int pushPendingItem(ExprPool* pool, ExprId id) {
+    if (pool->pendingCount == pool->pendingCapacity) {
+        uint newCapacity = pool->pendingCapacity ? pool->pendingCapacity * ARRAY_GROW_FACTOR : PENDING_ITEMS_START_CAP;
+        ExprId* newPending = (ExprId*) realloc(pool->pending, newCapacity * sizeof(ExprId));
+
+        if (newPending == NULL) return MALLOC_ERROR;
+        pool->pending = newPending;
+        pool->pendingCapacity = newCapacity;
+    }
+    pool->pending[pool->pendingCount++] = id;
+    return SUCCESS;
+}
+
+// list which begins at pending item `first` is moved to items
+// Ret: SUCCESS, MALLOC_ERROR
+int takePendingItems(ExprPool* pool, uint first, ExprRange* range) {
+    uint count = pool->pendingCount - first;
 
-    newNode->region.regStart = start;
-    newNode->region.regSize = size;
-    newNode->next = ctx->memRegList;
-    ctx->memRegList = newNode;
+    if (count > EXPR_POOL_MAX_ITEMS - pool->itemCount) return MALLOC_ERROR;
 
+    range->first = pool->itemCount;
+    range->count = count;
+    memcpy(pool->items + pool->itemCount, pool->pending + first, count * sizeof(ExprId));
+    pool->itemCount += count;
+    pool->pendingCount = first;
     return SUCCESS;
 }
 
-// 1 - can, 0 - cannot
-int ctxCanReadAddress(Context* ctx, void* ptr, size_t size) {
-    for (CtxMemoryRegionList* node = ctx->memRegList; node; node = node->next) {
-        if (ptr >= node->region.regStart && (char*) ptr + size <= (char*) node->region.regStart + node->region.regSize) return 1;
+// pages of big program are given back, the mappings are kept
+void resetExprPool(ExprPool* pool) {
+    size_t nodesSize = pool->nodeCount * sizeof(Expression);
+    size_t itemsSize = pool->itemCount * sizeof(ExprId);
+
+    if (nodesSize > EXPR_POOL_KEEP_SIZE) {
+        madvise((char*) pool->nodes + EXPR_POOL_KEEP_SIZE, nodesSize - EXPR_POOL_KEEP_SIZE, MADV_DONTNEED);
     }
-    return 0;
+    if (itemsSize > EXPR_POOL_KEEP_SIZE) {
+        madvise((char*) pool->items + EXPR_POOL_KEEP_SIZE, itemsSize - EXPR_POOL_KEEP_SIZE, MADV_DONTNEED);
+    }
+    if (pool->nodes != NULL) pool->nodeCount = 1;
+    pool->itemCount = 0;
+    pool->pendingCount = 0;
 }
 
-// Ret: SUCCESS, ERROR
-#define DEFINE_get(T) int get_##T(T* res, const ValueExpression* expr) { \
-    if (expr->type.pLevel != 0) { *res = (T) expr->st; return 0; }       \
-    switch (expr->type.pt) {                                             \
-        case PT_VOID:                                                    \
-            return ERROR;                                                \
-        case PT_CHAR:                                                    \
-            *res = (T) expr->c;                                          \
-            return SUCCESS;                                              \
-        case PT_UCHAR:                                                   \
-            *res = (T) expr->uc;                                         \
-            return SUCCESS;                                              \
-        case PT_SHORT:                                                   \
-            *res = (T) expr->s;                                          \
-            return SUCCESS;                                              \
-        case PT_USHORT:                                                  \
-            *res = (T) expr->us;                                         \
+void freeExprPool(ExprPool* pool) {
+    if (pool->nodes != NULL) {
+        munmap(pool->nodes, EXPR_POOL_MAX_NODES * sizeof(Expression));
+        munmap(pool->items, EXPR_POOL_MAX_ITEMS * sizeof(ExprId));
+    }
+    free(pool->pending);
+    memset(pool, 0, sizeof(ExprPool));
+}
+
+void initProgram(Program* prog) {
+    arenaInit(&prog->arena);
+    memset(&prog->exprs, 0, sizeof(ExprPool));
+    initSymbolTable(&prog->symbols);
+    prog->statements = NULL;
+    prog->statementCount = prog->statementCapacity = 0;
+    prog->declFields = NULL;
+    prog->declFieldCapacity = 0;
+    prog->tokens = NULL;
+    prog->tokenCapacity = 0;
+    prog->errorToken = NULL;
+    prog->errorOffset = 0;
+    prog->image = NULL;
+    prog->imageSize = 0;
+}
+
+// AST and names are dropped, storage is kept for the next program
+void resetProgram(Program* prog) {
+    prog->statementCount = 0;
+    arenaReset(&prog->arena);
+    resetExprPool(&prog->exprs);
+    resetSymbolTable(&prog->symbols);
+}
+
+// AST lives in the arena, statements of loaded program live in its image
+void freeProgram(Program* prog) {
+    if (prog->image != NULL) {
+        munmap(prog->image, prog->imageSize);
+        prog->image = NULL;
+        prog->imageSize = 0;
+        prog->statements = NULL;
+    }
+    free(prog->statements);
+    free(prog->declFields);
+    free(prog->tokens);
+    freeExprPool(&prog->exprs);
+    prog->statements = NULL;
+    prog->declFields = NULL;
+    prog->tokens = NULL;
+    prog->statementCount = prog->statementCapacity = prog->declFieldCapacity = prog->tokenCapacity = 0;
+    freeArena(&prog->arena);
+    freeSymbolTable(&prog->symbols);
+}
+
+// Ret: new statement at the end of program, it is counted when parsing succeeds; NULL - malloc error
+Statement* allocStatement(Program* prog) {
+    Statement* st;
+
+    if (prog->statementCount == prog->statementCapacity) {
+        int newCapacity = prog->statementCapacity ? prog->statementCapacity * ARRAY_GROW_FACTOR : STATEMENTS_START_CAP;
+        Statement* newStatements = (Statement*) realloc(prog->statements, newCapacity * sizeof(Statement));
+
+        if (newStatements == NULL) return NULL;
+        prog->statements = newStatements;
+        prog->statementCapacity = newCapacity;
+    }
+
+    st = &prog->statements[prog->statementCount];
+    memset(st, 0, sizeof(Statement));
+    return st;
+}
+
+// field n of declaration being parsed is made available and cleared
+// Ret: NULL - malloc error
+VarDeclField* allocDeclField(Program* prog, int n) {
+    if (n == prog->declFieldCapacity) {
+        int newCapacity = prog->declFieldCapacity ? prog->declFieldCapacity * ARRAY_GROW_FACTOR : DECL_FIELDS_START_CAP;
+        VarDeclField* newFields = (VarDeclField*) realloc(prog->declFields, newCapacity * sizeof(VarDeclField));
+
+        if (newFields == NULL) return NULL;
+        prog->declFields = newFields;
+        prog->declFieldCapacity = newCapacity;
+    }
+
+    memset(&prog->declFields[n], 0, sizeof(VarDeclField));
+    return &prog->declFields[n];
+}
+
+// variables table never moves, values point to variables. Table for more variables than symbols
+// has now is mapped, so only pages of declared variables take memory. Linear memory of
+// sandboxed context is mapped the same way
+// Ret: MALLOC_ERROR, SUCCESS
+int ctxInit(Context* ctx, const Program* prog, int maxVars, int isSandboxed) {
+    ctx->symbols = &prog->symbols;
+    ctx->exprs = &prog->exprs;
+    initCtxMemRegIndex(&ctx->memRegions);
+    ctx->hasEvaluationError = 0;
+    ctx->arrays = NULL;
+    ctx->arrayCount = ctx->arrayCapacity = 0;
+    ctx->params = NULL;
+    ctx->lanes = NULL;
+    ctx->slabs = NULL;
+    ctx->slabCount = ctx->slabCapacity = 0;
+    ctx->slabIndex = -1;
+    ctx->slabUsed = 0;
+    ctx->mem = NULL;
+    ctx->memUsed = SANDBOX_NULL_SIZE;
+
+    if (isSandboxed) {
+        void* p = mmap(NULL, SANDBOX_MEM_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        ctx->vars = NULL;
+        ctx->varCount = 0;
+        if (p == MAP_FAILED) return MALLOC_ERROR;
+        ctx->mem = (char*) p;
+    }
+
+    ctx->varCount = maxVars;
+    ctx->isVarsMapped = maxVars > prog->symbols.count;
+    if (ctx->isVarsMapped) {
+        void* p = mmap(NULL, maxVars * sizeof(*ctx->vars), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        ctx->vars = p != MAP_FAILED ? (CtxVariable*) p : NULL;
+    }
+    else {
+        ctx->vars = (CtxVariable*) calloc(maxVars ? maxVars : 1, sizeof(*ctx->vars));
+    }
+
+    if (ctx->vars == NULL) return MALLOC_ERROR;
+    return SUCCESS;
+}
+
+void freeContext(Context* ctx) {
+    if (ctx->isVarsMapped && ctx->vars != NULL) munmap(ctx->vars, ctx->varCount * sizeof(*ctx->vars));
+    else free(ctx->vars);
+    ctx->vars = NULL;
+    ctx->varCount = 0;
+    freeCtxMemRegIndex(&ctx->memRegions);
+
+    if (ctx->mem != NULL) munmap(ctx->mem, SANDBOX_MEM_SIZE);
+    ctx->mem = NULL;
+
+    for (int i = 0; i < ctx->arrayCount; i++) free(ctx->arrays[i]);
+    free(ctx->arrays);
+    ctx->arrays = NULL;
+    ctx->arrayCount = ctx->arrayCapacity = 0;
+
+    for (int i = 0; i < ctx->slabCount; i++) free(ctx->slabs[i]);
+    free(ctx->slabs);
+    ctx->slabs = NULL;
+    ctx->slabCount = ctx->slabCapacity = 0;
+    ctx->slabIndex = -1;
+
+    free(ctx->params);
+    ctx->params = NULL;
+    free(ctx->lanes);
+    ctx->lanes = NULL;
+}
+
+// variables of the program and their memory are dropped, storage is kept for the next program
+void ctxReset(Context* ctx) {
+    memset(ctx->vars, 0, min(ctx->symbols->count, ctx->varCount) * sizeof(*ctx->vars));
+    resetCtxMemRegIndex(&ctx->memRegions);
+    ctx->hasEvaluationError = 0;
+
+    // pages of big program are given back, kept ones are zeroed as given back ones
+    if (ctx->memUsed > SANDBOX_KEEP_SIZE) {
+        madvise(ctx->mem + SANDBOX_KEEP_SIZE, ctx->memUsed - SANDBOX_KEEP_SIZE, MADV_DONTNEED);
+    }
+    if (ctx->mem != NULL) memset(ctx->mem, 0, min(ctx->memUsed, SANDBOX_KEEP_SIZE));
+    ctx->memUsed = SANDBOX_NULL_SIZE;
+
+    for (int i = 0; i < ctx->arrayCount; i++) free(ctx->arrays[i]);
+    ctx->arrayCount = 0;
+
+    // bytes between variables of the next program are zero as in new slab
+    for (int i = 0; i <= ctx->slabIndex; i++) {
+        memset(ctx->slabs[i], 0, i < ctx->slabIndex ? VAR_SLAB_SIZE : ctx->slabUsed);
+    }
+    ctx->slabIndex = -1;
+    ctx->slabUsed = 0;
+}
+
+// array data is freed with context, it is freed right away on error
+// Ret: MALLOC_ERROR, SUCCESS
+int ctxAddArray(Context* ctx, void* data) {
+    if (ctx->arrayCount == ctx->arrayCapacity) {
+        int newCapacity = ctx->arrayCapacity == 0 ? 16 : ctx->arrayCapacity * ARRAY_GROW_FACTOR;
+        void** newArrays = (void**) realloc(ctx->arrays, newCapacity * sizeof(*newArrays));
+
+        if (newArrays == NULL) {
+            free(data);
+            return MALLOC_ERROR;
+        }
+        ctx->arrays = newArrays;
+        ctx->arrayCapacity = newCapacity;
+    }
+    ctx->arrays[ctx->arrayCount++] = data;
+    return SUCCESS;
+}
+
+int ctxAddMemoryRegion(Context* ctx, void* start, size_t size);
+
+// n bytes of memory of sandboxed context, align is a power of 2. They are dropped with all
+// variables by ctxReset
+// Ret: NULL - memory is full, data - success
+void* ctxAllocData(Context* ctx, size_t n, size_t align) {
+    size_t at = (ctx->memUsed + align - 1) & ~(align - 1);
+
+    if (n > SANDBOX_MEM_SIZE - at) return NULL;
+    ctx->memUsed = at + n;
+    return ctx->mem + at;
+}
+
+// n bytes aligned by n in slab of usual context, n is a power of 2 up to 8. New slab is zeroed
+// and added as memory region
+// Ret: NULL - malloc error, data - success
+void* ctxAllocSlab(Context* ctx, size_t n) {
+    size_t at = (ctx->slabUsed + n - 1) & ~(n - 1);
+
+    if (ctx->slabIndex == -1 || at + n > VAR_SLAB_SIZE) {
+        if (ctx->slabIndex + 1 == ctx->slabCount) {
+            char* slab;
+
+            if (ctx->slabCount == ctx->slabCapacity) {
+                int newCapacity = ctx->slabCapacity ? ctx->slabCapacity * ARRAY_GROW_FACTOR : VAR_SLABS_START_CAP;
+                char** newSlabs = (char**) realloc(ctx->slabs, newCapacity * sizeof(*newSlabs));
+
+                if (newSlabs == NULL) return NULL;
+                ctx->slabs = newSlabs;
+                ctx->slabCapacity = newCapacity;
+            }
+            slab = (char*) calloc(1, VAR_SLAB_SIZE);
+            if (slab == NULL) return NULL;
+            ctx->slabs[ctx->slabCount++] = slab;
+        }
+
+        at = 0;
+        if (ctxAddMemoryRegion(ctx, ctx->slabs[ctx->slabIndex + 1], n) != SUCCESS) return NULL;
+        ctx->slabIndex++;
+        ctx->slabRegion = ctx->memRegions.count - 1;
+    }
+
+    ctx->slabUsed = at + n;
+    ctx->memRegions.nodes[ctx->slabRegion].region.regSize = ctx->slabUsed;
+    return ctx->slabs[ctx->slabIndex] + at;
+}
+
+// Ret: ERROR - variable already defined, MALLOC_ERROR, SUCCESS
+int ctxRegisterVariable(Context* ctx, int slot, ValueExpression v, CtxVariable** toRetPtr) {
+    CtxVariable* var = &ctx->vars[slot];
+    int n = valueWidth(v.type);
+    if (var->isDefined) return ERROR;
+
+    var->data = ctx->mem != NULL ? ctxAllocData(ctx, n, n) : ctxAllocSlab(ctx, n);
+    if (var->data == NULL) return MALLOC_ERROR;
+
+    var->v = v;
+    var->isDefined = 1;
+    var->width = n;
+    memcpy(var->data, &v.ull, n);
+
+    if (toRetPtr != NULL)
+        *toRetPtr = var;
+
+    return SUCCESS;
+}
+
+// Ret: new root of the subtree
+int memRegIndexInsert(CtxMemoryRegionNode* nodes, int root, int n) {
+    CtxMemoryRegionNode* node = &nodes[n];
+    int* l,* r;
+
+    if (root == -1) return n;
+
+    if (node->priority <= nodes[root].priority) {
+        if (node->region.regStart < nodes[root].region.regStart)
+            nodes[root].left = memRegIndexInsert(nodes, nodes[root].left, n);
+        else
+            nodes[root].right = memRegIndexInsert(nodes, nodes[root].right, n);
+        return root;
+    }
+
+    // split subtree by regStart of the new node
+    l = &node->left;
+    r = &node->right;
+    while (root != -1) {
+        if (nodes[root].region.regStart < node->region.regStart) {
+            *l = root;
+            l = &nodes[root].right;
+            root = *l;
+        }
+        else {
+            *r = root;
+            r = &nodes[root].left;
+            root = *r;
+        }
+    }
+    *l = *r = -1;
+    return n;
+}
+
+// Ret: MALLOC_ERROR, SUCCESS
+int ctxAddMemoryRegion(Context* ctx, void* start, size_t size) {
+    CtxMemoryRegionIndex* idx = &ctx->memRegions;
+    CtxMemoryRegionNode* node;
+
+    if (size == 0 || ctx->mem != NULL) return SUCCESS;
+
+    if (idx->count == idx->capacity) {
+        int newCap = idx->capacity ? idx->capacity * 2 : MEM_REGION_INDEX_START_CAP;
+        CtxMemoryRegionNode* newNodes = (CtxMemoryRegionNode*) realloc(idx->nodes, newCap * sizeof(*newNodes));
+        if (newNodes == NULL) {
+            return MALLOC_ERROR;
+        }
+        idx->nodes = newNodes;
+        idx->capacity = newCap;
+    }
+
+    // xorshift
+    idx->seed ^= idx->seed << 13;
+    idx->seed ^= idx->seed >> 17;
+    idx->seed ^= idx->seed << 5;
+
+    node = &idx->nodes[idx->count];
+    node->region.regStart = start;
+    node->region.regSize = size;
+    node->priority = idx->seed;
+    node->left = node->right = -1;
+
+    idx->root = memRegIndexInsert(idx->nodes, idx->root, idx->count++);
+    return SUCCESS;
+}
+
+// 1 - can, 0 - cannot
+int ctxCanReadAddress(Context* ctx, void* ptr, size_t size) {
+    CtxMemoryRegionIndex* idx = &ctx->memRegions;
+    CtxMemoryRegion* reg;
+    int n = idx->root, found = -1;
+
+    if (idx->lastHit != -1) {
+        reg = &idx->nodes[idx->lastHit].region;
+        if (ptr >= reg->regStart && (char*) ptr + size <= (char*) reg->regStart + reg->regSize) return 1;
+    }
+
+    while (n != -1) {
+        if (idx->nodes[n].region.regStart <= ptr) {
+            found = n;
+            n = idx->nodes[n].right;
+        }
+        else n = idx->nodes[n].left;
+    }
+    if (found == -1) return 0;
+
+    reg = &idx->nodes[found].region;
+    if ((char*) ptr + size > (char*) reg->regStart + reg->regSize) return 0;
+
+    idx->lastHit = found;
+    return 1;
+}
+
+// pointer of the program to n bytes is translated to host address, memory of sandboxed
+// context is checked by one comparison of bounds
+// Ret: NULL - program cannot access to the bytes, address - success
+void* ctxAddress(Context* ctx, size ptr, size_t n) {
+    if (ctx->mem != NULL) {
+        return ptr >= SANDBOX_NULL_SIZE && ptr <= ctx->memUsed - n ? ctx->mem + ptr : NULL;
+    }
+    return ctxCanReadAddress(ctx, (void*) ptr, n) ? (void*) ptr : NULL;
+}
+
+// Ret: pointer of the program to host address of variable or array
+size ctxPointer(const Context* ctx, const void* p) {
+    return ctx->mem != NULL ? (size) ((const char*) p - ctx->mem) : (size) p;
+}
+
+// Ret: SUCCESS, ERROR
+#define DEFINE_get(T) int get_##T(T* res, const ValueExpression* expr) { \
+    if (expr->type.pLevel != 0) { *res = (T) expr->st; return 0; }       \
+    switch (expr->type.pt) {                                             \
+        case PT_VOID:                                                    \
+            return ERROR;                                                \
+        case PT_CHAR:                                                    \
+            *res = (T) expr->c;                                          \
+            return SUCCESS;                                              \
+        case PT_UCHAR:                                                   \
+            *res = (T) expr->uc;                                         \
+            return SUCCESS;                                              \
+        case PT_SHORT:                                                   \
+            *res = (T) expr->s;                                          \
+            return SUCCESS;                                              \
+        case PT_USHORT:                                                  \
+            *res = (T) expr->us;                                         \
             return SUCCESS;                                              \
         case PT_INT:                                                     \
             *res = (T) expr->i;                                          \
@@ -1057,44 +2023,6 @@ int probablyError(const ValueExpression* v) {
     return v->type.pt == PT_VOID && v->type.pLevel == 0;
 }
 
-void freeExpression(Expression* expr) {
-    switch (expr->type)
-    {
-        case EXPR_ASSIGNMENT:
-            freeExpression(expr->ae.expr1);
-            expr->ae.expr1 = NULL;
-            freeExpression(expr->ae.expr2);
-            expr->ae.expr2 = NULL;
-            break;
-        case EXPR_BINARY:
-            freeExpression(expr->be.expr1);
-            expr->be.expr1 = NULL;
-            freeExpression(expr->be.expr2);
-            expr->be.expr2 = NULL;
-            break;
-        case EXPR_UNARY:
-            freeExpression(expr->ue.expr);
-            expr->ue.expr = NULL;
-            break;
-        case EXPR_CAST:
-            freeExpression(expr->ce.expr);
-            expr->ce.expr = NULL;
-            break;
-        case EXPR_VARIABLE:
-            break;
-        case EXPR_VALUE:
-            break;
-        case EXPR_COMMA:
-            freeExpressionList(expr->cme.exprs);
-            expr->cme.exprs = NULL;
-            break;
-        default:
-            error("Bad expression type %d", expr->type);
-            break;
-    }
-    free(expr);
-}
-
 PrimitiveType getCastType(PrimitiveType t1, PrimitiveType t2) {
     return t1 > t2 ? t1 : t2;
 }
@@ -1103,19 +2031,19 @@ ValueExpression evaluateExpression(Context* ctx, int* changesAnyLValue, Expressi
 
 ValueExpression getLValuePtrVariable(Context* ctx, int* changesAnyLValue, const VariableExpression* expr) {
     ValueExpression v;
-    CtxVariable* var = ctxGetVariable(ctx, expr->name);
+    CtxVariable* var = ctxGetVariable(ctx, expr->slot);
     initValueExpression(&v);
     *changesAnyLValue = 0;
 
     if (var == NULL) {
-        evalError("Cannot find variable `%s`", expr->name);
+        evalError("Cannot find variable `%s`", ctx->symbols->names[expr->slot]);
         return v;
     }
 
     if (var->v.type.pLevel != 0) {
         v.type = var->v.type;
         v.type.pLevel++;
-        v.st = (size) &var->v.st;
+        v.st = ctxPointer(ctx, var->data);
         return v;
     }
 
@@ -1136,7 +2064,7 @@ ValueExpression getLValuePtrVariable(Context* ctx, int* changesAnyLValue, const
         case PT_ULONGLONG:
         case PT_FLOAT:
         case PT_DOUBLE:
-            v.st = (size) &var->v.c;
+            v.st = ctxPointer(ctx, var->data);
             break;
         
         default:
@@ -1150,7 +2078,7 @@ ValueExpression getLValuePtrVariable(Context* ctx, int* changesAnyLValue, const
 }
 
 ValueExpression getLValuePtrPointerDef(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
-    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, expr->expr);
+    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));
 
     if (ve.type.pLevel == 0) {
         ValueExpression v;
@@ -1166,13 +2094,13 @@ ValueExpression getLValuePtrPointerDef(Context* ctx, int* changesAnyLValue, Unar
 ValueExpression getLValuePtrBrackets(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
     ValueExpression ve1, ve2;
     ValueExpression v;
-    size ptr, offset;
+    size ptr, offset = 0;
     int factor, changes = 0;
 
-    ve1 = evaluateExpression(ctx, &changes, expr->expr1);
+    ve1 = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr1));
     if (changes) *changesAnyLValue = 1;
     changes = 0;
-    ve2 = evaluateExpression(ctx, &changes, expr->expr2);
+    ve2 = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr2));
     if (changes) *changesAnyLValue = 1;
 
     initValueExpression(&v);
@@ -1220,23 +2148,29 @@ ValueExpression getLValuePtr(Context* ctx, int* changesAnyLValue, Expression* ex
 
 #define CASE(T, t, F, OP1, OP2) case PT_##T:                                \
                                 case PT_U##T:                               \
-                                    toRet. F = OP1 (*(t*)lValuePtr.st) OP2; \
+                                    toRet. F = OP1 (*(t*)p) OP2;            \
                                     break;
 
 #define DEFINE_evaluateUnary(NAME, OP1, OP2, C1, C2)                                                \
 ValueExpression evaluateUnary##NAME(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {   \
     ValueExpression toRet;                                                                          \
-    ValueExpression lValuePtr = getLValuePtr(ctx, changesAnyLValue, expr->expr);                    \
+    ValueExpression lValuePtr = getLValuePtr(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));\
+    void* p;                                                                                        \
     *changesAnyLValue = 1;                                                                          \
     initValueExpression(&toRet);                                                                    \
     if (probablyError(&lValuePtr)) {                                                                \
         evalError("Expression is not lvalue");                                                      \
         return toRet;                                                                               \
     }                                                                                               \
+    p = ctxAddress(ctx, lValuePtr.st, lValuePtr.type.pLevel != 1 ? sizeof(size) : sizeOf(lValuePtr.type.pt));\
+    if (p == NULL) {                                                                                \
+        evalError("Cannot access to address");                                                      \
+        return toRet;                                                                               \
+    }                                                                                               \
     if (lValuePtr.type.pLevel != 1) {                                                               \
         toRet.type.pLevel = lValuePtr.type.pLevel - 1;                                              \
         toRet.type.pt = lValuePtr.type.pt;                                                          \
-        toRet.st = OP1 (*(size*)lValuePtr.st) OP2;                                                  \
+        toRet.st = OP1 (*(size*)p) OP2;                                                             \
         return toRet;                                                                               \
     }                                                                                               \
     switch (lValuePtr.type.pt) {                                                                    \
@@ -1264,7 +2198,7 @@ DEFINE_evaluateUnary(PDec, , --, toRet = *ve, )
 
 ValueExpression evaluateUnaryBNot(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
     ValueExpression toRet;
-    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, expr->expr);
+    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));
     initValueExpression(&toRet);
 
     if (ve.type.pLevel != 0) {
@@ -1290,7 +2224,7 @@ ValueExpression evaluateUnaryBNot(Context* ctx, int* changesAnyLValue, UnaryExpr
 }
 
 ValueExpression evaluateUnaryMinus(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
-    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, expr->expr);
+    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));
     ValueExpression toRet;
     initValueExpression(&toRet);
 
@@ -1339,7 +2273,7 @@ ValueExpression getLogicalValue(Context* ctx, int* changesAnyLValue, Expression*
 }
 
 ValueExpression evaluateUnaryLNot(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
-    ValueExpression lValue = getLogicalValue(ctx, changesAnyLValue, expr->expr);
+    ValueExpression lValue = getLogicalValue(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));
 
     if (probablyError(&lValue)) {
         evalError("Cannot do !void");
@@ -1351,51 +2285,28 @@ ValueExpression evaluateUnaryLNot(Context* ctx, int* changesAnyLValue, UnaryExpr
 }
 
 ValueExpression evaluateUnaryAddrOf(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
-    return getLValuePtr(ctx, changesAnyLValue, expr->expr);
+    return getLValuePtr(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));
 }
 
-ValueExpression evaluateUnaryPtrDer(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
+// value which pointer points to
+// value of type t is read from host address p which is checked
+ValueExpression loadValue(const void* p, Type t) {
     ValueExpression toRet;
-    ValueExpression ve = evaluateExpression(ctx, changesAnyLValue, expr->expr);
-    int dSize;
 
     initValueExpression(&toRet);
 
-    if (ve.type.pLevel == 0) {
-        evalError("Cannot do *(non-pointer value)");
-        return toRet;
-    }
-
-    if (ve.type.pLevel > 1) {
-        if (!ctxCanReadAddress(ctx, (void*)ve.st, sizeof(size))) {
-            evalError("Cannot access to address");
-            return toRet;
-        }
-
-        toRet.type = ve.type;
-        toRet.type.pLevel--;
-        
-        toRet.st = *(size*)ve.st;
-        return toRet;
-    }
-
-    dSize = sizeOf(ve.type.pt);
-    if (dSize == 0) {
-        evalError("Cannot get size of void type");
-        return toRet;
-    }
-
-    if (!ctxCanReadAddress(ctx, (void*)ve.st, dSize)) {
-        evalError("Cannot access to address");
+    if (t.pLevel != 0) {
+        toRet.type = t;
+        toRet.st = *(const size*)p;
         return toRet;
     }
 
-    #define CASE(T, t, F)   case PT_##T:              \
-                            case PT_U##T:             \
-                                toRet. F = *(t*)ve.st;\
+    #define CASE(T, t, F)   case PT_##T:                    \
+                            case PT_U##T:                   \
+                                toRet. F = *(const t*)p;    \
                                 break;
 
-    switch (ve.type.pt) {
+    switch (t.pt) {
         case PT_VOID: break;
         CASE(CHAR, char, c)
         CASE(SHORT, short, s)
@@ -1404,23 +2315,54 @@ ValueExpression evaluateUnaryPtrDer(Context* ctx, int* changesAnyLValue, UnaryEx
         CASE(LONGLONG, longlong, ll)
         
         case PT_FLOAT:
-            toRet.f = *(float*)ve.st;
+            toRet.f = *(const float*)p;
             break;
         case PT_DOUBLE:
-            toRet.d = *(double*)ve.st;
+            toRet.d = *(const double*)p;
             break;
 
         default:
-            error("Bad primitive type %d", ve.type.pt);
+            error("Bad primitive type %d", t.pt);
             break;
     }
 
     #undef CASE
 
-    toRet.type.pt = ve.type.pt;
+    toRet.type.pt = t.pt;
     return toRet;
 }
 
+ValueExpression derefValue(Context* ctx, ValueExpression ve) {
+    ValueExpression toRet;
+    void* p;
+    int dSize;
+
+    initValueExpression(&toRet);
+
+    if (ve.type.pLevel == 0) {
+        evalError("Cannot do *(non-pointer value)");
+        return toRet;
+    }
+
+    ve.type.pLevel--;
+    dSize = valueWidth(ve.type);
+    if (dSize == 0) {
+        evalError("Cannot get size of void type");
+        return toRet;
+    }
+
+    p = ctxAddress(ctx, ve.st, dSize);
+    if (p == NULL) {
+        evalError("Cannot access to address");
+        return toRet;
+    }
+    return loadValue(p, ve.type);
+}
+
+ValueExpression evaluateUnaryPtrDer(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
+    return derefValue(ctx, evaluateExpression(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr)));
+}
+
 ValueExpression evaluateUnary(Context* ctx, int* changesAnyLValue, UnaryExpression* expr) {
     switch (expr->op)
     {
@@ -1433,7 +2375,7 @@ ValueExpression evaluateUnary(Context* ctx, int* changesAnyLValue, UnaryExpressi
         case OPU_P_DEC: // i--
             return evaluateUnaryPDec(ctx, changesAnyLValue, expr);
         case OPU_PLUS:
-            return evaluateExpression(ctx, changesAnyLValue, expr->expr);
+            return evaluateExpression(ctx, changesAnyLValue, exprAt(ctx->exprs, expr->expr));
         case OPU_MINUS:
             return evaluateUnaryMinus(ctx, changesAnyLValue, expr);
         case OPU_LNOT: // !i
@@ -1456,19 +2398,11 @@ ValueExpression evaluateUnary(Context* ctx, int* changesAnyLValue, UnaryExpressi
     }
 }
 
-ValueExpression evaluateBinaryAdd(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
-    ValueExpression v1, v2;
+ValueExpression applyBinaryAdd(Context* ctx, ValueExpression v1, ValueExpression v2) {
     ValueExpression toRet;
     PrimitiveType castPType;
     Type castType;
-    int factor, changes = 0;
-
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);
-    if (changes) *changesAnyLValue = 1;
-    changes = 0;
-
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);
-    if (changes) *changesAnyLValue = 1;
+    int factor;
 
     initValueExpression(&toRet);
     
@@ -1546,19 +2480,11 @@ ValueExpression evaluateBinaryAdd(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;
 }
 
-ValueExpression evaluateBinarySub(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
-    ValueExpression v1, v2;
+ValueExpression applyBinarySub(Context* ctx, ValueExpression v1, ValueExpression v2) {
     ValueExpression toRet;
     PrimitiveType castPType;
     Type castType;
-    int factor, changes = 0;
-
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);
-    if (changes) *changesAnyLValue = 1;
-    changes = 0;
-
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);
-    if (changes) *changesAnyLValue = 1;
+    int factor;
 
     initValueExpression(&toRet);
     
@@ -1626,19 +2552,10 @@ ValueExpression evaluateBinarySub(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;
 }
 
-ValueExpression evaluateBinaryMul(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
-    ValueExpression v1, v2;
+ValueExpression applyBinaryMul(Context* ctx, ValueExpression v1, ValueExpression v2) {
     ValueExpression toRet;
     PrimitiveType castPType;
     Type castType;
-    int changes = 0;
-
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);
-    if (changes) *changesAnyLValue = 1;
-    changes = 0;
-
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);
-    if (changes) *changesAnyLValue = 1;
 
     initValueExpression(&toRet);
     
@@ -1679,19 +2596,10 @@ ValueExpression evaluateBinaryMul(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;
 }
 
-ValueExpression evaluateBinaryDiv(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
-    ValueExpression v1, v2;
+ValueExpression applyBinaryDiv(Context* ctx, ValueExpression v1, ValueExpression v2) {
     ValueExpression toRet;
     PrimitiveType castPType;
     Type castType;
-    int changes = 0;
-
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);
-    if (changes) *changesAnyLValue = 1;
-    changes = 0;
-
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);
-    if (changes) *changesAnyLValue = 1;
 
     initValueExpression(&toRet);
     
@@ -1732,19 +2640,10 @@ ValueExpression evaluateBinaryDiv(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;
 }
 
-ValueExpression evaluateBinaryMod(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
-    ValueExpression v1, v2;
+ValueExpression applyBinaryMod(Context* ctx, ValueExpression v1, ValueExpression v2) {
     ValueExpression toRet;
     PrimitiveType castPType;
     Type castType;
-    int changes = 0;
-
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);
-    if (changes) *changesAnyLValue = 1;
-    changes = 0;
-
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);
-    if (changes) *changesAnyLValue = 1;
 
     initValueExpression(&toRet);
     
@@ -1789,20 +2688,11 @@ ValueExpression evaluateBinaryMod(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;
 }
 
-#define DEFINE_evaluateBinary(N, OP)                                                                \
-ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {    \
-    ValueExpression v1, v2;                                                                         \
+#define DEFINE_applyBinary(N, OP)                                                                   \
+ValueExpression applyBinary##N(Context* ctx, ValueExpression v1, ValueExpression v2) {              \
     ValueExpression toRet;                                                                          \
     PrimitiveType castPType;                                                                        \
     Type castType;                                                                                  \
-    int changes = 0;                                                                                \
-                                                                                                    \
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);                                            \
-    if (changes) *changesAnyLValue = 1;                                                             \
-    changes = 0;                                                                                    \
-                                                                                                    \
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);                                            \
-    if (changes) *changesAnyLValue = 1;                                                             \
                                                                                                     \
     initValueExpression(&toRet);                                                                    \
                                                                                                     \
@@ -1851,29 +2741,20 @@ ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;                                                                                   \
 }
 
-DEFINE_evaluateBinary(Eq, ==)
-DEFINE_evaluateBinary(Neq, !=)
-DEFINE_evaluateBinary(Gr, >)
-DEFINE_evaluateBinary(Lr, <)
-DEFINE_evaluateBinary(Gre, >=)
-DEFINE_evaluateBinary(Lre, <=)
+DEFINE_applyBinary(Eq, ==)
+DEFINE_applyBinary(Neq, !=)
+DEFINE_applyBinary(Gr, >)
+DEFINE_applyBinary(Lr, <)
+DEFINE_applyBinary(Gre, >=)
+DEFINE_applyBinary(Lre, <=)
 
-#undef DEFINE_evaluateBinary
+#undef DEFINE_applyBinary
 
-#define DEFINE_evaluateBinary(N, OP)                                                                \
-ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {    \
-    ValueExpression v1, v2;                                                                         \
+#define DEFINE_applyBinary(N, OP)                                                                   \
+ValueExpression applyBinary##N(Context* ctx, ValueExpression v1, ValueExpression v2) {              \
     ValueExpression toRet;                                                                          \
     PrimitiveType castPType;                                                                        \
     Type castType;                                                                                  \
-    int changes = 0;                                                                                \
-                                                                                                    \
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);                                            \
-    if (changes) *changesAnyLValue = 1;                                                             \
-    changes = 0;                                                                                    \
-                                                                                                    \
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);                                            \
-    if (changes) *changesAnyLValue = 1;                                                             \
                                                                                                     \
     initValueExpression(&toRet);                                                                    \
                                                                                                     \
@@ -1908,24 +2789,24 @@ ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;                                                                                   \
 }
 
-DEFINE_evaluateBinary(Band, &)
-DEFINE_evaluateBinary(Bor, |)
-DEFINE_evaluateBinary(Xor, ^)
+DEFINE_applyBinary(Band, &)
+DEFINE_applyBinary(Bor, |)
+DEFINE_applyBinary(Xor, ^)
 
-#undef DEFINE_evaluateBinary
+#undef DEFINE_applyBinary
 
 #define DEFINE_evaluateBinary(N, OP)                                                                \
 ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {    \
     ValueExpression v1, v2;                                                                         \
     int changes = 0;                                                                                \
-    v2 = getLogicalValue(ctx, &changes, expr->expr2);                                               \
+    v2 = getLogicalValue(ctx, &changes, exprAt(ctx->exprs, expr->expr2));                           \
     if (changes) *changesAnyLValue = 1;                                                             \
     if (probablyError(&v2)) {                                                                       \
         evalError("Cannot do " #OP " with void");                                                   \
         return v1;                                                                                  \
     }                                                                                               \
     changes = 0;                                                                                    \
-    v1 = getLogicalValue(ctx, &changes, expr->expr1);                                               \
+    v1 = getLogicalValue(ctx, &changes, exprAt(ctx->exprs, expr->expr1));                           \
     if (changes) *changesAnyLValue = 1;                                                             \
     if (probablyError(&v1)) {                                                                       \
         evalError("Cannot do " #OP " with void");                                                   \
@@ -1940,22 +2821,13 @@ DEFINE_evaluateBinary(Lor, ||)
 
 #undef DEFINE_evaluateBinary
 
-#define DEFINE_evaluateBinary(N, OP)                                                                \
-ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {    \
-    ValueExpression v1, v2;                                                                         \
+#define DEFINE_applyBinary(N, OP)                                                                   \
+ValueExpression applyBinary##N(Context* ctx, ValueExpression v1, ValueExpression v2) {              \
     ValueExpression toRet;                                                                          \
     PrimitiveType castPType;                                                                        \
     Type castType;                                                                                  \
-    int changes = 0;                                                                                \
                                                                                                     \
-    v2 = evaluateExpression(ctx, &changes, expr->expr2);                                            \
-    if (changes) *changesAnyLValue = 1;                                                             \
-    changes = 0;                                                                                    \
-                                                                                                    \
-    v1 = evaluateExpression(ctx, &changes, expr->expr1);                                            \
-    if (changes) *changesAnyLValue = 1;                                                             \
-                                                                                                    \
-    initValueExpression(&toRet);                                                                    \
+    initValueExpression(&toRet);                                                                    \
                                                                                                     \
     if (v1.type.pLevel != 0 || v2.type.pLevel != 0) {                                               \
         evalError("Cannot bitwise with ptr");                                                       \
@@ -2019,19 +2891,77 @@ ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExp
     return toRet;                                                                                   \
 }
 
-DEFINE_evaluateBinary(Lsh, <<)
-DEFINE_evaluateBinary(Rsh, >>)
+DEFINE_applyBinary(Lsh, <<)
+DEFINE_applyBinary(Rsh, >>)
+
+#undef DEFINE_applyBinary
+
+// operands are evaluated right to left, then the operator is applied to their values
+#define DEFINE_evaluateBinary(N)                                                                    \
+ValueExpression evaluateBinary##N(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {    \
+    ValueExpression v1, v2;                                                                         \
+    int changes = 0;                                                                                \
+                                                                                                    \
+    v2 = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr2));                        \
+    if (changes) *changesAnyLValue = 1;                                                             \
+    changes = 0;                                                                                    \
+                                                                                                    \
+    v1 = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr1));                        \
+    if (changes) *changesAnyLValue = 1;                                                             \
+                                                                                                    \
+    return applyBinary##N(ctx, v1, v2);                                                             \
+}
+
+DEFINE_evaluateBinary(Add)
+DEFINE_evaluateBinary(Sub)
+DEFINE_evaluateBinary(Mul)
+DEFINE_evaluateBinary(Div)
+DEFINE_evaluateBinary(Mod)
+DEFINE_evaluateBinary(Eq)
+DEFINE_evaluateBinary(Neq)
+DEFINE_evaluateBinary(Gr)
+DEFINE_evaluateBinary(Lr)
+DEFINE_evaluateBinary(Gre)
+DEFINE_evaluateBinary(Lre)
+DEFINE_evaluateBinary(Band)
+DEFINE_evaluateBinary(Bor)
+DEFINE_evaluateBinary(Xor)
+DEFINE_evaluateBinary(Lsh)
+DEFINE_evaluateBinary(Rsh)
 
 #undef DEFINE_evaluateBinary
 
+// operators of compound assignments
+ValueExpression applyBinary(Context* ctx, BinaryOperatorType op, ValueExpression v1, ValueExpression v2) {
+    switch (op) {
+        case OPB_ADD: return applyBinaryAdd(ctx, v1, v2);
+        case OPB_SUB: return applyBinarySub(ctx, v1, v2);
+        case OPB_MUL: return applyBinaryMul(ctx, v1, v2);
+        case OPB_DIV: return applyBinaryDiv(ctx, v1, v2);
+        case OPB_MOD: return applyBinaryMod(ctx, v1, v2);
+        case OPB_LSH: return applyBinaryLsh(ctx, v1, v2);
+        case OPB_RSH: return applyBinaryRsh(ctx, v1, v2);
+        case OPB_BAND: return applyBinaryBand(ctx, v1, v2);
+        case OPB_BOR: return applyBinaryBor(ctx, v1, v2);
+        case OPB_XOR: return applyBinaryXor(ctx, v1, v2);
+        default: {
+            ValueExpression v;
+            initValueExpression(&v);
+            error("Bad binary operator %d", op);
+            return v;
+        }
+    }
+}
+
 ValueExpression evaluateSquareBrackets(Context* ctx, int* changesAnyLValue, BinaryExpression* expr) {
     ValueExpression whatVe, offsetVe, toRet;
     size offset, ptr;
+    void* p;
     int changes = 0, dSize;
 
     initValueExpression(&toRet);
 
-    whatVe = evaluateExpression(ctx, &changes, expr->expr1);
+    whatVe = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr1));
     if (changes) *changesAnyLValue = 1;
     changes = 0;
 
@@ -2040,7 +2970,7 @@ ValueExpression evaluateSquareBrackets(Context* ctx, int* changesAnyLValue, Bina
         return toRet;
     }
     
-    offsetVe = evaluateExpression(ctx, &changes, expr->expr2);
+    offsetVe = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr2));
     if (changes) *changesAnyLValue = 1;
 
     if (offsetVe.type.pLevel != 0) {
@@ -2064,14 +2994,15 @@ ValueExpression evaluateSquareBrackets(Context* ctx, int* changesAnyLValue, Bina
     ptr += offset * getPointerOperationFactor(&whatVe.type);
 
     if (whatVe.type.pLevel >= 2) {
-        if (!ctxCanReadAddress(ctx, (void*)ptr, sizeof(size))) {
+        p = ctxAddress(ctx, ptr, sizeof(size));
+        if (p == NULL) {
             evalError("Cannot access to address");
             return toRet;
         }
 
         toRet.type.pt = whatVe.type.pt;
         toRet.type.pLevel = whatVe.type.pLevel - 1;
-        toRet.st = *(size*)ptr;
+        toRet.st = *(size*)p;
         return toRet;
     }
 
@@ -2081,12 +3012,13 @@ ValueExpression evaluateSquareBrackets(Context* ctx, int* changesAnyLValue, Bina
         return toRet;
     }
 
-    if (!ctxCanReadAddress(ctx, (void*)ptr, dSize)) {
+    p = ctxAddress(ctx, ptr, dSize);
+    if (p == NULL) {
         evalError("Cannot access to address");
         return toRet;
     }
 
-    #define CASE(T, t, F) case PT_##T: case PT_U##T: toRet. F = *(t*)ptr; break;
+    #define CASE(T, t, F) case PT_##T: case PT_U##T: toRet. F = *(t*)p; break;
 
     switch (whatVe.type.pt)
     {
@@ -2099,10 +3031,10 @@ ValueExpression evaluateSquareBrackets(Context* ctx, int* changesAnyLValue, Bina
         CASE(LONG, long, l)
         CASE(LONGLONG, longlong, ll)
         case PT_FLOAT:
-            toRet.f = *(float*)ptr;
+            toRet.f = *(float*)p;
             break;
         case PT_DOUBLE:
-            toRet.d = *(double*)ptr;
+            toRet.d = *(double*)p;
             break;
         
         default:
@@ -2167,60 +3099,27 @@ ValueExpression evaluateBinary(Context* ctx, int* changesAnyLValue, BinaryExpres
     }
 }
 
-ValueExpression evaluateAT(Context* ctx, int* changesAnyLValue, AssignmentExpression* expr) {
-    ValueExpression to, what, voidRet;
-    Type castType;
-    int changes = 0, dSize;
+// what is casted to type t and stored at host address p which is checked
+ValueExpression storeValueAt(Context* ctx, int* changesAnyLValue, void* p, Type t, ValueExpression what) {
+    ValueExpression voidRet;
 
     initValueExpression(&voidRet);
 
-    what = evaluateExpression(ctx, &changes, expr->expr2);
-    if (changes) *changesAnyLValue = 1;
-
-    if (probablyError(&what)) {
-        return what;
-    }
-
-    to = getLValuePtr(ctx, &changes, expr->expr1);
-    if (changes) *changesAnyLValue = 1;
-
-    if (probablyError(&to)) {
-        return to;
-    }
-
-    castType = to.type;
-    castType.pLevel--;
-
-    what = castTo(castType, &what);
+    what = castTo(t, &what);
 
-    if (castType.pLevel != 0) {
-        if (!ctxCanReadAddress(ctx, (void*)to.st, sizeof(size))) {
-            evalError("Cannot access to address");
-            return voidRet;
-        }
-        *(size*)to.st = what.st;
+    if (t.pLevel != 0) {
+        *(size*)p = what.st;
         return what;
     }
 
-    dSize = sizeOf(to.type.pt);
-    if (dSize == 0) {
-        evalError("Cannot get size of void type");
-        return voidRet;
-    }
-
-    if (!ctxCanReadAddress(ctx, (void*)to.st, dSize)) {
-        evalError("Cannot access to address");
-        return voidRet;
-    }
-
     #define CASE(T, t, F)   case PT_##T:                                        \
                             case PT_U##T:                                       \
                                 if (!*changesAnyLValue)                         \
-                                    *changesAnyLValue = *(t*)to.st != what. F;  \
-                                *(t*)to.st = what. F;                           \
+                                    *changesAnyLValue = *(t*)p != what. F;      \
+                                *(t*)p = what. F;                               \
                                 break;
 
-    switch (to.type.pt) {
+    switch (t.pt) {
         CASE(CHAR, char, c)
         CASE(SHORT, short, s)
         CASE(INT, int, i)
@@ -2228,17 +3127,17 @@ ValueExpression evaluateAT(Context* ctx, int* changesAnyLValue, AssignmentExpres
         CASE(LONGLONG, longlong, ll)
         case PT_FLOAT:
             if (!*changesAnyLValue)
-                *changesAnyLValue = *(float*)to.st != what.f;
-            *(float*)to.st = what.f;
+                *changesAnyLValue = *(float*)p != what.f;
+            *(float*)p = what.f;
             break;
         case PT_DOUBLE:
             if (!*changesAnyLValue)
-                *changesAnyLValue = *(double*)to.st != what.d;
-            *(double*)to.st = what.d;
+                *changesAnyLValue = *(double*)p != what.d;
+            *(double*)p = what.d;
             break;
         
         default:
-            error("Bad primitive type %d", to.type.pt)
+            error("Bad primitive type %d", t.pt)
             return voidRet;
     }
 
@@ -2246,1441 +3145,4736 @@ ValueExpression evaluateAT(Context* ctx, int* changesAnyLValue, AssignmentExpres
     return what;
 }
 
-#define PASTE(OP)                                                               \
-    {int changes = 0;                                                           \
-    Expression binary, newAt, unpack, vPtr;                                     \
-    ValueExpression toRet, lvPtr = getLValuePtr(ctx, &changes, expr->expr1);    \
-    if (probablyError(&lvPtr)) {                                                \
-        evalError("Cannot get lvalue");                                         \
-        return lvPtr;                                                           \
-    };                                                                          \
-    if (changes) *changesAnyLValue = 1;                                         \
-    vPtr.type = EXPR_VALUE;                                                     \
-    vPtr.vle = lvPtr;                                                           \
-    unpack.type = EXPR_UNARY;                                                   \
-    unpack.ue.op = OPU_PTR_DER;                                                 \
-    unpack.ue.expr = &vPtr;                                                     \
-    binary.type = EXPR_BINARY;                                                  \
-    binary.be.op = OP;                                                          \
-    binary.be.expr1 = &unpack;                                                  \
-    binary.be.expr2 = expr->expr2;                                              \
-    newAt.type = EXPR_ASSIGNMENT;                                               \
-    newAt.ae.op = OPA_AT;                                                       \
-    newAt.ae.expr1 = &unpack;                                                   \
-    newAt.ae.expr2 = &binary;                                                   \
-    changes = 0;                                                                \
-    toRet = evaluateAT(ctx, &changes, &newAt.ae);                               \
-    if (changes) *changesAnyLValue = 1;                                         \
-    return toRet;}
+// what is casted to type of lvalue and stored by its address to
+ValueExpression storeValue(Context* ctx, int* changesAnyLValue, ValueExpression to, ValueExpression what) {
+    ValueExpression voidRet;
+    void* p;
+    int dSize;
+
+    initValueExpression(&voidRet);
+
+    to.type.pLevel--;
+    dSize = valueWidth(to.type);
+    if (dSize == 0) {
+        evalError("Cannot get size of void type");
+        return voidRet;
+    }
+
+    p = ctxAddress(ctx, to.st, dSize);
+    if (p == NULL) {
+        evalError("Cannot access to address");
+        return voidRet;
+    }
+    return storeValueAt(ctx, changesAnyLValue, p, to.type, what);
+}
+
+ValueExpression evaluateAT(Context* ctx, int* changesAnyLValue, AssignmentExpression* expr) {
+    ValueExpression to, what;
+    int changes = 0;
+
+    what = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr2));
+    if (changes) *changesAnyLValue = 1;
+
+    if (probablyError(&what)) {
+        return what;
+    }
+
+    to = getLValuePtr(ctx, &changes, exprAt(ctx->exprs, expr->expr1));
+    if (changes) *changesAnyLValue = 1;
+
+    if (probablyError(&to)) {
+        return to;
+    }
+
+    return storeValue(ctx, changesAnyLValue, to, what);
+}
+
+// `lvalue OP= expr2` is `*p = *p OP expr2` where the address p of lvalue is evaluated and
+// checked once, the value is read and written by the same host address
+ValueExpression evaluateCompoundAssignment(Context* ctx, int* changesAnyLValue, AssignmentExpression* expr) {
+    static const BinaryOperatorType compoundOps[] = {
+        OPB_ADD, OPB_SUB, OPB_MUL, OPB_DIV, OPB_MOD, OPB_LSH, OPB_RSH, OPB_BAND, OPB_BOR, OPB_XOR,
+    };
+    ValueExpression lvPtr, v2, what;
+    Type t;
+    void* p;
+    int changes = 0, dSize;
+
+    lvPtr = getLValuePtr(ctx, &changes, exprAt(ctx->exprs, expr->expr1));
+    if (probablyError(&lvPtr)) {
+        evalError("Cannot get lvalue");
+        return lvPtr;
+    }
+    if (changes) *changesAnyLValue = 1;
+
+    changes = 0;
+    v2 = evaluateExpression(ctx, &changes, exprAt(ctx->exprs, expr->expr2));
+    if (changes) *changesAnyLValue = 1;
+
+    initValueExpression(&what);
+    t = lvPtr.type;
+    t.pLevel--;
+    dSize = valueWidth(t);
+    if (dSize == 0) {
+        evalError("Cannot get size of void type");
+        return what;
+    }
+
+    p = ctxAddress(ctx, lvPtr.st, dSize);
+    if (p == NULL) {
+        evalError("Cannot access to address");
+        return what;
+    }
+
+    changes = 0;
+    what = applyBinary(ctx, compoundOps[expr->op - OPA_ADD_AT], loadValue(p, t), v2);
+    if (!probablyError(&what)) what = storeValueAt(ctx, &changes, p, t, what);
+    if (changes) *changesAnyLValue = 1;
+    return what;
+}
 
 ValueExpression evaluateAssignment(Context* ctx, int* changesAnyLValue, AssignmentExpression* expr) {
     switch (expr->op) {
         case OPA_AT:
             return evaluateAT(ctx, changesAnyLValue, expr);
-        case OPA_ADD_AT: 
-            PASTE(OPB_ADD);
+        case OPA_ADD_AT:
         case OPA_SUB_AT:
-            PASTE(OPB_SUB);
         case OPA_MUL_AT:
-            PASTE(OPB_MUL);
         case OPA_DIV_AT:
-            PASTE(OPB_DIV);
         case OPA_MOD_AT:
-            PASTE(OPB_MOD);
         case OPA_LSH_AT:
-            PASTE(OPB_LSH);
         case OPA_RSH_AT:
-            PASTE(OPB_RSH);
         case OPA_BAND_AT:
-            PASTE(OPB_BAND);
         case OPA_BOR_AT:
-            PASTE(OPB_BOR);
         case OPA_XOR_AT:
-            PASTE(OPB_XOR);
+            return evaluateCompoundAssignment(ctx, changesAnyLValue, expr);
         default: {
             ValueExpression v;
             initValueExpression(&v);
             error("Bad assignment operator %d", expr->op);
             return v;
-        }  
+        }
     }
 }
 
-#undef PASTE
+// Types of expressions known before running. Implicit conversions of operators are made explicit
+// with casts, so the code for an operator depends on the types of its operands only. Roots which
+// type depends on running keep void type and are left to the tree walker as they are
+typedef struct {
+    ExprPool* exprs;
+    Type* slotTypes; // void - variable is not declared before the statement
+    Context* foldCtx; // evaluates subexpressions of constants
+} TypeResolver;
 
-ValueExpression evaluateExpression(Context* ctx, int* changesAnyValue, Expression* expr) {
-    switch (expr->type)
-    {
-        case EXPR_ASSIGNMENT:
-            return evaluateAssignment(ctx, changesAnyValue, &expr->ae);
-        case EXPR_BINARY:
-            return evaluateBinary(ctx, changesAnyValue, &expr->be);
-        case EXPR_UNARY:
-            return evaluateUnary(ctx, changesAnyValue, &expr->ue);
-        case EXPR_CAST: {
-            ValueExpression ve = evaluateExpression(ctx, changesAnyValue, expr->ce.expr);
-            ve = castTo(expr->ce.type, &ve);
-            if (probablyError(&ve)) {
-                evalError("Cannot cast types");
-            }
-            return ve;
-        }
-        case EXPR_VARIABLE: {
-            CtxVariable* var = ctxGetVariable(ctx, expr->ve.name);
-            if (var == NULL) {
-                ValueExpression v;
-                initValueExpression(&v);
+int isVoidType(Type t) {
+    return t.pt == PT_VOID && t.pLevel == 0;
+}
 
-                evalError("Cannot find variable `%s`", expr->ve.name);
-                return v;
-            }
-            *changesAnyValue = 0;
-            return var->v;
-        }
-        case EXPR_VALUE:
-            *changesAnyValue = 0;
-            return expr->vle;
-        case EXPR_COMMA:
-            *changesAnyValue = 0;
+// castTo gives non-void value
+int canCast(Type from, Type to) {
+    if (to.pLevel != 0) {
+        return from.pLevel != 0 || (from.pt != PT_FLOAT && from.pt != PT_DOUBLE && from.pt != PT_VOID);
+    }
+    return to.pt != PT_VOID && !isVoidType(from);
+}
 
-            for (ExpressionList* node = expr->cme.exprs; ; node = node->next) {
-                int changes = 0;
-                if (node->next != NULL) {
-                    evaluateExpression(ctx, &changes, node->expr);
-                    if (changes) *changesAnyValue = 1;
-                }
-                else {
-                    ValueExpression ve = evaluateExpression(ctx, &changes, node->expr);
-                    if (changes) *changesAnyValue = 1;
+// expression is wrapped into implicit cast when its type differs, constants are casted in place
+// Ret: SUCCESS, MALLOC_ERROR
+int castImplicitly(ExprPool* pool, ExprId* id, Type to) {
+    Expression* expr = exprAt(pool, *id),* cast;
 
-                    return ve;
-                }
-            }
-            error("Error cannot be there");
-        default: {
-            ValueExpression v;
-            initValueExpression(&v);
-            *changesAnyValue = 0;
-            error("Cannot evaluate expression type %d", expr->type);
-            return v;
-        }   
+    if (expr->valueType.pt == to.pt && expr->valueType.pLevel == to.pLevel) return SUCCESS;
+    if (expr->type == EXPR_VALUE) {
+        expr->vle = castTo(to, &expr->vle);
+        expr->valueType = to;
+        return SUCCESS;
     }
-}
 
-// Ret: ERROR, MALLOC_ERROR, SUCCESS
-int interpretStatement(int* fChanges, Context* ctx, Statement* statement) {
-    ctx->hasEvaluationError = 0;
+    cast = allocExpression(pool, EXPR_CAST);
+    if (cast == NULL) return MALLOC_ERROR;
+    cast->ce.type = to;
+    cast->ce.expr = *id;
+    cast->ce.isImplicit = 1;
+    cast->valueType = to;
+    *id = exprId(pool, cast);
+    return SUCCESS;
+}
 
-    switch (statement->type)
-    {
-        case ST_VARIABLE_DECLARATION:
-            for (int i = 0; i < statement->vs.vAmount; i++) {
-                VarDeclField* f = &statement->vs.variables[i];
-                int j, regStatus, factor, dSize;
-                CtxVariable var,* registeredVarPtr;
-                Type declType;
-                ValueExpression ve;
-                ExpressionList* node;
+// operands of arithmetic, bitwise and compare operators are casted to common type
+int isCastingOperator(BinaryOperatorType op, Type t1, Type t2) {
+    return op != OPB_LAND && op != OPB_LOR && op != OPB_SQ_BRACKETS && t1.pLevel == 0 && t2.pLevel == 0;
+}
 
-                initValueExpression(&ve);
-                declType.pLevel = f->pLevel;
-                declType.pt = statement->vs.vType;
+// evaluateBinary* for operands of known types, factor is set for pointer arithmetic
+// Ret: SUCCESS, ERROR - evaluation fails
+int resolveBinaryType(BinaryOperatorType op, Type t1, Type t2, Type* t, int* factor) {
+    PrimitiveType castPType;
 
-                if (declType.pt == PT_VOID && declType.pLevel == 0) {
-                    evalError("Cannot create variable with void type");
-                    return ERROR;
+    *factor = 0;
+    switch (op) {
+        case OPB_ADD:
+        case OPB_SUB:
+            if (t1.pLevel != 0) {
+                if (t2.pLevel != 0) {
+                    if (op == OPB_ADD || t1.pLevel != t2.pLevel || t1.pt != t2.pt) return ERROR;
+                    *factor = 1;
+                    *t = t1;
+                    return SUCCESS;
                 }
+                if (t2.pt == PT_VOID || t2.pt == PT_FLOAT || t2.pt == PT_DOUBLE) return ERROR;
+                *factor = getPointerOperationFactor(&t1);
+                *t = t1;
+                return *factor != 0 ? SUCCESS : ERROR;
+            }
+            if (t2.pLevel != 0) {
+                if (op == OPB_SUB || t1.pt == PT_VOID || t1.pt == PT_FLOAT || t1.pt == PT_DOUBLE) return ERROR;
+                *factor = getPointerOperationFactor(&t2);
+                *t = t2;
+                return *factor != 0 ? SUCCESS : ERROR;
+            }
+            break;
+        case OPB_MUL:
+        case OPB_DIV:
+            break;
+        case OPB_MOD:
+        case OPB_LSH:
+        case OPB_RSH:
+        case OPB_BAND:
+        case OPB_BOR:
+        case OPB_XOR:
+            if (t1.pLevel == 0 && t2.pLevel == 0 &&
+                (t1.pt == PT_FLOAT || t1.pt == PT_DOUBLE || t2.pt == PT_FLOAT || t2.pt == PT_DOUBLE)) return ERROR;
+            break;
+        case OPB_EQ:
+        case OPB_NEQ:
+        case OPB_GR:
+        case OPB_LR:
+        case OPB_GRE:
+        case OPB_LRE:
+            if (t1.pLevel != 0 && t2.pLevel != 0) {
+                if (t1.pLevel != t2.pLevel || t1.pt != t2.pt) return ERROR;
+                t->pt = PT_INT;
+                t->pLevel = 0;
+                return SUCCESS;
+            }
+            break;
+        case OPB_LAND:
+        case OPB_LOR:
+            if (t1.pt == PT_VOID || t2.pt == PT_VOID) return ERROR;
+            t->pt = PT_INT;
+            t->pLevel = 0;
+            return SUCCESS;
+        default:
+            return ERROR;
+    }
 
-                if (f->isArray) {
-                    void* ptr; 
-                    int arrSize;
-
-                    ve.type = declType;
-                    ve.type.pLevel++;
+    if (t1.pLevel != 0 || t2.pLevel != 0) return ERROR;
+    castPType = getCastType(t1.pt, t2.pt);
+    if (castPType == PT_VOID) return ERROR;
 
-                    factor = getPointerOperationFactor(&ve.type);
-                    if (factor == 0) {
-                        evalError("Cannot get size of array type");
-                        return ERROR;
-                    }
+    t->pt = op >= OPB_EQ && op <= OPB_LRE ? PT_INT : castPType;
+    t->pLevel = 0;
+    return SUCCESS;
+}
 
-                    arrSize = f->arraySize;
-                    if (arrSize == 0) {
-                        for (node = f->exprList; node != NULL; node = node->next) arrSize++;
-                    }
+// subexpression which evaluation cannot fail, so it gives the same value without operator around it
+int isAccessFree(const ExprPool* pool, const Expression* expr) {
+    switch (expr->type) {
+        case EXPR_VALUE:
+        case EXPR_VARIABLE:
+            return 1;
+        case EXPR_CAST:
+            return isAccessFree(pool, exprAt(pool, expr->ce.expr));
+        case EXPR_UNARY:
+            switch (expr->ue.op) {
+                case OPU_PTR_DER:
+                    return 0;
+                case OPU_PLUS:
+                case OPU_MINUS:
+                case OPU_LNOT:
+                case OPU_BNOT:
+                    return isAccessFree(pool, exprAt(pool, expr->ue.expr));
+                default:
+                    return exprAt(pool, expr->ue.expr)->type == EXPR_VARIABLE;
+            }
+        case EXPR_BINARY:
+            return expr->be.op != OPB_SQ_BRACKETS && isAccessFree(pool, exprAt(pool, expr->be.expr1)) &&
+                   isAccessFree(pool, exprAt(pool, expr->be.expr2));
+        case EXPR_ASSIGNMENT:
+            return exprAt(pool, expr->ae.expr1)->type == EXPR_VARIABLE && isAccessFree(pool, exprAt(pool, expr->ae.expr2));
+        case EXPR_COMMA:
+            for (uint i = 0; i < expr->cme.exprs.count; i++) {
+                if (!isAccessFree(pool, exprAt(pool, exprItem(pool, expr->cme.exprs, i)))) return 0;
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
 
-                    ptr = malloc(factor * arrSize);
-                    if (ptr == NULL) {
-                        error("Cannot allocate array for variable");
-                        return MALLOC_ERROR;
-                    }
-                    f->arrDataPtr = ptr;
+// Ret: 1 - expression is integer constant equal to value, 0 - otherwise
+int isIntegerConstant(const Expression* expr, longlong value) {
+    longlong v;
 
-                    if (ctxAddMemoryRegion(ctx, ptr, arrSize * factor) != SUCCESS) {
-                        error("Memory allocation error");
-                        free(ptr);
-                        f->arrDataPtr = NULL;
-                        return MALLOC_ERROR;
-                    }
+    if (expr->type != EXPR_VALUE || expr->valueType.pLevel != 0) return 0;
+    if (expr->valueType.pt == PT_FLOAT || expr->valueType.pt == PT_DOUBLE) return 0;
+    return get_longlong(&v, &expr->vle) == SUCCESS && v == value;
+}
 
-                    for (j = 0, node = f->exprList; node != NULL; j++, node = node->next) {
-                        ValueExpression evaluated;
-                        if (j >= arrSize) {
-                            evalError("Too many expressions in array");
-                            free(ptr);
-                            f->arrDataPtr = NULL;
-                            return ERROR;
-                        }
+// `x + 0`, `x * 1` and alike for integer operands already casted to type of operator,
+// floats are not simplified because of signed zeros
+// Ret: operand equal to the whole expression, NULL - no identity
+Expression* getIdentityOperand(const ExprPool* pool, const BinaryExpression* be) {
+    Expression* e1 = exprAt(pool, be->expr1),* e2 = exprAt(pool, be->expr2);
+    Expression* x = NULL;
 
-                        evaluated = evaluateExpression(ctx, fChanges, node->expr);
+    if (e1->valueType.pLevel != 0 || e2->valueType.pLevel != 0) return NULL;
 
-                        if (evaluated.type.pt != declType.pt || evaluated.type.pLevel != declType.pLevel) {
-                            evaluated = castTo(declType, &evaluated);
-                            if (probablyError(&evaluated)) {
-                                evalError("Cannot cast evaluated value to array type");
-                                free(ptr);
-                                f->arrDataPtr = NULL;
+    switch (be->op) {
+        case OPB_ADD:
+        case OPB_BOR:
+        case OPB_XOR:
+            if (isIntegerConstant(e1, 0)) x = e2;
+            else if (isIntegerConstant(e2, 0)) x = e1;
+            break;
+        case OPB_MUL:
+            if (isIntegerConstant(e1, 1)) x = e2;
+            else if (isIntegerConstant(e2, 1)) x = e1;
+            break;
+        case OPB_SUB:
+        case OPB_LSH:
+        case OPB_RSH:
+            if (isIntegerConstant(e2, 0)) x = e1;
+            break;
+        case OPB_DIV:
+            if (isIntegerConstant(e2, 1)) x = e1;
+            break;
+        default:
+            break;
+    }
+
+    if (x == NULL || x->valueType.pt == PT_FLOAT || x->valueType.pt == PT_DOUBLE || !isAccessFree(pool, x)) return NULL;
+    return x;
+}
+
+// resolved expression which operands are constants is replaced with its value,
+// unary plus and algebraic identities are replaced with their operand
+void foldExpression(TypeResolver* r, Expression* expr) {
+    ExprPool* pool = r->exprs;
+    ValueExpression v;
+    Expression* x;
+    int changes = 0;
+
+    switch (expr->type) {
+        case EXPR_CAST:
+            if (exprAt(pool, expr->ce.expr)->type != EXPR_VALUE) return;
+            break;
+        case EXPR_UNARY:
+            if (expr->ue.op == OPU_PLUS) {
+                *expr = *exprAt(pool, expr->ue.expr);
+                return;
+            }
+            if (expr->ue.op != OPU_MINUS && expr->ue.op != OPU_LNOT && expr->ue.op != OPU_BNOT) return;
+            if (exprAt(pool, expr->ue.expr)->type != EXPR_VALUE) return;
+            break;
+        case EXPR_BINARY:
+            if (expr->be.op == OPB_SQ_BRACKETS) return;
+            if (exprAt(pool, expr->be.expr1)->type != EXPR_VALUE || exprAt(pool, expr->be.expr2)->type != EXPR_VALUE) {
+                if ((x = getIdentityOperand(pool, &expr->be)) != NULL) *expr = *x;
+                return;
+            }
+            // integer division traps are left for running
+            if ((expr->be.op == OPB_DIV || expr->be.op == OPB_MOD) &&
+                (isIntegerConstant(exprAt(pool, expr->be.expr2), 0) ||
+                 isIntegerConstant(exprAt(pool, expr->be.expr2), -1))) return;
+            break;
+        case EXPR_COMMA:
+            for (uint i = 0; i < expr->cme.exprs.count; i++) {
+                if (exprAt(pool, exprItem(pool, expr->cme.exprs, i))->type != EXPR_VALUE) return;
+            }
+            break;
+        default:
+            return;
+    }
+
+    v = evaluateExpression(r->foldCtx, &changes, expr);
+    if (r->foldCtx->hasEvaluationError) {
+        error("Error cannot be there");
+        r->foldCtx->hasEvaluationError = 0;
+        return;
+    }
+    expr->type = EXPR_VALUE;
+    expr->vle = v;
+}
+
+int resolveExpression(TypeResolver* r, Expression* expr);
+
+// getLValuePtr, type of lvalue is the type of value it points to
+// Ret: SUCCESS, ERROR - cannot be resolved, MALLOC_ERROR
+int resolveLValue(TypeResolver* r, Expression* expr) {
+    int err;
+    Type t, t2;
+
+    switch (expr->type) {
+        case EXPR_VARIABLE:
+            t = r->slotTypes[expr->ve.slot];
+            if (isVoidType(t)) return ERROR;
+            break;
+        case EXPR_UNARY:
+            if (expr->ue.op != OPU_PTR_DER) return ERROR;
+            if ((err = resolveExpression(r, exprAt(r->exprs, expr->ue.expr))) != SUCCESS) return err;
+
+            t = exprAt(r->exprs, expr->ue.expr)->valueType;
+            if (t.pLevel == 0) return ERROR;
+            t.pLevel--;
+            break;
+        case EXPR_BINARY:
+            if (expr->be.op != OPB_SQ_BRACKETS) return ERROR;
+            if ((err = resolveExpression(r, exprAt(r->exprs, expr->be.expr1))) != SUCCESS) return err;
+            if ((err = resolveExpression(r, exprAt(r->exprs, expr->be.expr2))) != SUCCESS) return err;
+
+            t = exprAt(r->exprs, expr->be.expr1)->valueType;
+            t2 = exprAt(r->exprs, expr->be.expr2)->valueType;
+            if (t2.pLevel != 0 || t2.pt == PT_VOID || t2.pt == PT_FLOAT || t2.pt == PT_DOUBLE) return ERROR;
+            if (t.pLevel == 0) return ERROR;
+            // void* is not indexed, its factor is 0
+            expr->be.factor = getPointerOperationFactor(&t);
+            if (expr->be.factor == 0) return ERROR;
+            t.pLevel--;
+            break;
+        default:
+            return ERROR;
+    }
+
+    expr->valueType = t;
+    return SUCCESS;
+}
+
+// Ret: SUCCESS, ERROR - cannot be resolved, MALLOC_ERROR
+int resolveUnary(TypeResolver* r, Expression* expr, Type* t) {
+    int err;
+
+    switch (expr->ue.op) {
+        case OPU_INC:
+        case OPU_DEC:
+        case OPU_P_INC:
+        case OPU_P_DEC:
+            if ((err = resolveLValue(r, exprAt(r->exprs, expr->ue.expr))) != SUCCESS) return err;
+            *t = exprAt(r->exprs, expr->ue.expr)->valueType;
+            if (t->pLevel == 0 && (t->pt == PT_FLOAT || t->pt == PT_DOUBLE)) return ERROR;
+            return SUCCESS;
+        case OPU_ADDR_OF:
+            if ((err = resolveLValue(r, exprAt(r->exprs, expr->ue.expr))) != SUCCESS) return err;
+            *t = exprAt(r->exprs, expr->ue.expr)->valueType;
+            t->pLevel++;
+            return SUCCESS;
+        case OPU_PTR_DER:
+            if ((err = resolveLValue(r, expr)) != SUCCESS) return err;
+            *t = expr->valueType;
+            return SUCCESS;
+        default:
+            break;
+    }
+
+    if ((err = resolveExpression(r, exprAt(r->exprs, expr->ue.expr))) != SUCCESS) return err;
+    *t = exprAt(r->exprs, expr->ue.expr)->valueType;
+
+    switch (expr->ue.op) {
+        case OPU_PLUS:
+            return SUCCESS;
+        case OPU_MINUS:
+            return t->pLevel == 0 ? SUCCESS : ERROR;
+        case OPU_LNOT:
+            t->pt = PT_INT;
+            t->pLevel = 0;
+            return SUCCESS;
+        case OPU_BNOT:
+            return t->pLevel == 0 && t->pt != PT_FLOAT && t->pt != PT_DOUBLE ? SUCCESS : ERROR;
+        default:
+            return ERROR;
+    }
+}
+
+// Ret: SUCCESS, ERROR - cannot be resolved, MALLOC_ERROR
+int resolveAssignment(TypeResolver* r, Expression* expr, Type* t) {
+    static const BinaryOperatorType compoundOps[] = {
+        OPB_ADD, OPB_SUB, OPB_MUL, OPB_DIV, OPB_MOD, OPB_LSH, OPB_RSH, OPB_BAND, OPB_BOR, OPB_XOR,
+    };
+    BinaryOperatorType op;
+    Type t2, opType;
+    int err, factor;
+
+    if ((err = resolveExpression(r, exprAt(r->exprs, expr->ae.expr2))) != SUCCESS) return err;
+    if ((err = resolveLValue(r, exprAt(r->exprs, expr->ae.expr1))) != SUCCESS) return err;
+    *t = exprAt(r->exprs, expr->ae.expr1)->valueType;
+    t2 = exprAt(r->exprs, expr->ae.expr2)->valueType;
+    // nothing is stored through void*
+    if (isVoidType(*t)) return ERROR;
+
+    if (expr->ae.op == OPA_AT) {
+        if (!canCast(t2, *t)) return ERROR;
+        return castImplicitly(r->exprs, &expr->ae.expr2, *t);
+    }
+
+    // `*lvalue = *lvalue OP expr2`, the old value is casted by compiled code
+    op = compoundOps[expr->ae.op - OPA_ADD_AT];
+    if (resolveBinaryType(op, *t, t2, &opType, &factor) != SUCCESS) return ERROR;
+    if (!canCast(opType, *t)) return ERROR;
+    if (isCastingOperator(op, *t, t2)) {
+        opType.pt = getCastType(t->pt, t2.pt);
+        opType.pLevel = 0;
+        return castImplicitly(r->exprs, &expr->ae.expr2, opType);
+    }
+    return SUCCESS;
+}
+
+// valueType of expression and all its subexpressions is set on success
+// Ret: SUCCESS, ERROR - cannot be resolved, MALLOC_ERROR
+int resolveExpression(TypeResolver* r, Expression* expr) {
+    int err = SUCCESS;
+    Type t;
+
+    switch (expr->type) {
+        case EXPR_VALUE:
+            t = expr->vle.type;
+            break;
+        case EXPR_VARIABLE:
+            t = r->slotTypes[expr->ve.slot];
+            break;
+        case EXPR_CAST:
+            if ((err = resolveExpression(r, exprAt(r->exprs, expr->ce.expr))) != SUCCESS) return err;
+            if (!canCast(exprAt(r->exprs, expr->ce.expr)->valueType, expr->ce.type)) return ERROR;
+            t = expr->ce.type;
+            break;
+        case EXPR_UNARY:
+            err = resolveUnary(r, expr, &t);
+            break;
+        case EXPR_ASSIGNMENT:
+            err = resolveAssignment(r, expr, &t);
+            break;
+        case EXPR_BINARY: {
+            BinaryExpression* be = &expr->be;
+            Type t1, t2;
+
+            if (be->op == OPB_SQ_BRACKETS) {
+                err = resolveLValue(r, expr);
+                t = expr->valueType;
+                break;
+            }
+            if ((err = resolveExpression(r, exprAt(r->exprs, be->expr1))) != SUCCESS) return err;
+            if ((err = resolveExpression(r, exprAt(r->exprs, be->expr2))) != SUCCESS) return err;
+            t1 = exprAt(r->exprs, be->expr1)->valueType;
+            t2 = exprAt(r->exprs, be->expr2)->valueType;
+            if (resolveBinaryType(be->op, t1, t2, &t, &be->factor) != SUCCESS) return ERROR;
+
+            if (isCastingOperator(be->op, t1, t2)) {
+                Type castType;
+
+                castType.pt = getCastType(t1.pt, t2.pt);
+                castType.pLevel = 0;
+                if (castImplicitly(r->exprs, &be->expr1, castType) != SUCCESS) return MALLOC_ERROR;
+                if (castImplicitly(r->exprs, &be->expr2, castType) != SUCCESS) return MALLOC_ERROR;
+            }
+            break;
+        }
+        case EXPR_COMMA:
+            for (uint i = 0; i < expr->cme.exprs.count; i++) {
+                Expression* item = exprAt(r->exprs, exprItem(r->exprs, expr->cme.exprs, i));
+
+                if ((err = resolveExpression(r, item)) != SUCCESS) return err;
+                t = item->valueType;
+            }
+            break;
+        default:
+            return ERROR;
+    }
+
+    if (err != SUCCESS) return err;
+    if (isVoidType(t)) return ERROR;
+    expr->valueType = t;
+    foldExpression(r, expr);
+    return SUCCESS;
+}
+
+// root keeps void type when it cannot be resolved, initializer is casted to type of variable
+// Ret: SUCCESS, MALLOC_ERROR
+int resolveRoot(TypeResolver* r, ExprId* root, const Type* declType) {
+    Expression* expr = exprAt(r->exprs, *root);
+    int err = resolveExpression(r, expr);
+
+    if (err == MALLOC_ERROR) return MALLOC_ERROR;
+    if (err != SUCCESS) {
+        expr->valueType.pt = PT_VOID;
+        expr->valueType.pLevel = 0;
+        return SUCCESS;
+    }
+    if (declType != NULL && canCast(expr->valueType, *declType)) {
+        return castImplicitly(r->exprs, root, *declType);
+    }
+    return SUCCESS;
+}
+
+// variables declared by the statement are added to types known for the next statements
+// Ret: SUCCESS, MALLOC_ERROR
+int resolveStatement(TypeResolver* r, Statement* st) {
+    int status = SUCCESS;
+
+    switch (st->type) {
+        case ST_EXPRESSION:
+            return resolveRoot(r, &st->es.expr, NULL);
+        case ST_PRINT:
+            return resolveRoot(r, &st->ps.expr, NULL);
+        case ST_VARIABLE_DECLARATION:
+            for (int i = 0; i < st->vs.vAmount && status == SUCCESS; i++) {
+                VarDeclField* f = &st->vs.variables[i];
+                Type declType;
+
+                declType.pt = st->vs.vType;
+                declType.pLevel = f->pLevel;
+
+                if (f->isArray) {
+                    for (uint j = 0; j < f->inits.count && status == SUCCESS; j++) {
+                        status = resolveRoot(r, &exprItem(r->exprs, f->inits, j), &declType);
+                    }
+                    declType.pLevel++;
+                }
+                else if (f->expr != 0) {
+                    status = resolveRoot(r, &f->expr, &declType);
+                }
+
+                // redeclaration and void variables stop the program
+                if (isVoidType(r->slotTypes[f->slot])) r->slotTypes[f->slot] = declType;
+            }
+            return status;
+        default:
+            return SUCCESS;
+    }
+}
+
+// array which inits are all folded to constants of its element type is initialized by memcpy
+// of packed values, they are kept in arena of the program
+// Ret: SUCCESS, MALLOC_ERROR
+int packArrayInits(Program* prog, Statement* st) {
+    if (st->type != ST_VARIABLE_DECLARATION) return SUCCESS;
+
+    for (int i = 0; i < st->vs.vAmount; i++) {
+        VarDeclField* f = &st->vs.variables[i];
+        Type t;
+        uint j;
+        int width;
+        char* values;
+
+        t.pt = st->vs.vType;
+        t.pLevel = f->pLevel;
+        if (!f->isArray || f->inits.count == 0 || isVoidType(t)) continue;
+
+        for (j = 0; j < f->inits.count; j++) {
+            Expression* item = exprAt(&prog->exprs, exprItem(&prog->exprs, f->inits, j));
+            if (item->type != EXPR_VALUE || item->valueType.pt != t.pt || item->valueType.pLevel != t.pLevel) break;
+        }
+        if (j != f->inits.count) continue;
+
+        width = valueWidth(t);
+        values = (char*) arenaAlloc(&prog->arena, (size_t) f->inits.count * width);
+        if (values == NULL) return MALLOC_ERROR;
+
+        // value of any type is at the beginning of the union
+        for (j = 0; j < f->inits.count; j++) {
+            memcpy(values + (size_t) j * width, &exprAt(&prog->exprs, exprItem(&prog->exprs, f->inits, j))->vle.ull, width);
+        }
+        f->values = values;
+    }
+    return SUCCESS;
+}
+
+// Root expressions resolved by resolveStatement are compiled to type-specialized
+// register code. Compiled code doesn't report errors: on access error it rolls back all
+// its writes and the expression is evaluated again by the tree walker
+#define VM_MAX_REGS 256
+#define VM_MAX_UNDO 256
+#define VM_CODE_START_CAP 64
+
+// pseudo primitive type for pointer values in conversions
+#define VM_PTR_TYPE _PT_END
+
+// X(A, suffix, C type, register field), A is passed through
+#define VM_INT_TYPES(X, A)                                                                      \
+    X(A, CHAR, char, c) X(A, UCHAR, uchar, uc) X(A, SHORT, short, s) X(A, USHORT, ushort, us)   \
+    X(A, INT, int, i) X(A, UINT, uint, ui) X(A, LONG, long, l) X(A, ULONG, ulong, ul)           \
+    X(A, LONGLONG, longlong, ll) X(A, ULONGLONG, ulonglong, ull)
+
+#define VM_TYPES(X, A) VM_INT_TYPES(X, A) X(A, FLOAT, float, f) X(A, DOUBLE, double, d)
+#define VM_TYPES_PTR(X, A) VM_TYPES(X, A) X(A, PTR, size, st)
+
+// fields of evaluateBinaryAdd, evaluateBinarySub and evaluateBinaryMul
+#define VM_ADD_TYPES(X, A)                                                                              \
+    X(A, CHAR, uchar, uc) X(A, UCHAR, uchar, uc) X(A, SHORT, ushort, us) X(A, USHORT, ushort, us)       \
+    X(A, INT, uint, ui) X(A, UINT, uint, ui) X(A, LONG, ulong, ul) X(A, ULONG, ulong, ul)               \
+    X(A, LONGLONG, ulonglong, ull) X(A, ULONGLONG, ulonglong, ull) X(A, FLOAT, float, f) X(A, DOUBLE, double, d)
+
+// fields of evaluateBinaryLsh and evaluateBinaryRsh
+#define VM_SHIFT_TYPES(X, A)                                                                    \
+    X(A, CHAR, char, c) X(A, UCHAR, char, c) X(A, SHORT, short, s) X(A, USHORT, ushort, us)     \
+    X(A, INT, int, i) X(A, UINT, uint, ui) X(A, LONG, ulong, ul) X(A, ULONG, long, l)           \
+    X(A, LONGLONG, longlong, ll) X(A, ULONGLONG, ulonglong, ull)
+
+// fields of evaluateUnaryMinus
+#define VM_NEG_TYPES(X, A)                                                                      \
+    X(A, CHAR, char, c) X(A, UCHAR, char, c) X(A, SHORT, short, s) X(A, USHORT, short, s)       \
+    X(A, INT, int, i) X(A, UINT, int, i) X(A, LONG, long, l) X(A, ULONG, long, l)               \
+    X(A, LONGLONG, longlong, ll) X(A, ULONGLONG, longlong, ll) X(A, FLOAT, float, f) X(A, DOUBLE, double, d)
+
+// memory access widths in bytes 1, 2, 4, 8, unsigned for loads and stores, signed for ++ and --
+#define VM_WIDTHS(X, A) X(A, 8, uchar, uc) X(A, 16, ushort, us) X(A, 32, uint, ui) X(A, 64, ulonglong, ull)
+#define VM_INC_WIDTHS(X, A) X(A, 8, char, c) X(A, 16, short, s) X(A, 32, int, i) X(A, 64, longlong, ll)
+
+#define VM_OPCODES(X, Y)                                                                            \
+    X(END) X(CONST) X(SMALL_CONST) VM_WIDTHS(Y, LOAD_VAR)                                      \
+    X(ADDR_VAR) VM_WIDTHS(Y, LOAD) VM_WIDTHS(Y, STORE) X(STORE_FLOAT) X(STORE_DOUBLE) X(STORE_PTR)  \
+    VM_INC_WIDTHS(Y, INC) VM_INC_WIDTHS(Y, DEC) VM_INC_WIDTHS(Y, P_INC) VM_INC_WIDTHS(Y, P_DEC)     \
+    X(SEXT_CHAR) X(SEXT_SHORT) X(SEXT_INT) X(SEXT_LONG) X(FLOAT_TO_DOUBLE)                         \
+    VM_TYPES_PTR(Y, CVT_LL) VM_TYPES_PTR(Y, CVT_ULL) VM_TYPES_PTR(Y, CVT_D)                         \
+    VM_ADD_TYPES(Y, ADD) VM_ADD_TYPES(Y, SUB) VM_ADD_TYPES(Y, MUL) VM_TYPES(Y, DIV)                 \
+    VM_INT_TYPES(Y, MOD) VM_SHIFT_TYPES(Y, LSH) VM_SHIFT_TYPES(Y, RSH)                               \
+    VM_TYPES_PTR(Y, EQ) VM_TYPES_PTR(Y, NEQ) VM_TYPES_PTR(Y, GR) VM_TYPES_PTR(Y, LR)                \
+    VM_TYPES_PTR(Y, GRE) VM_TYPES_PTR(Y, LRE) VM_NEG_TYPES(Y, NEG)                                   \
+    X(BAND) X(BOR) X(XOR) X(LAND) X(LOR) X(LNOT)                                                   \
+    VM_WIDTHS(Y, BNOT) VM_WIDTHS(Y, PTR_ADD) VM_WIDTHS(Y, PTR_SUB)                                  \
+    VM_ADD_TYPES(Y, ADD_AT) VM_ADD_TYPES(Y, SUB_AT) VM_ADD_TYPES(Y, MUL_AT) VM_TYPES(Y, DIV_AT)     \
+    VM_INT_TYPES(Y, MOD_AT) VM_SHIFT_TYPES(Y, LSH_AT) VM_SHIFT_TYPES(Y, RSH_AT)                     \
+    VM_WIDTHS(Y, BAND_AT) VM_WIDTHS(Y, BOR_AT) VM_WIDTHS(Y, XOR_AT)
+
+#define VM_ENUM_OP(N) OP_##N,
+#define VM_ENUM_TYPED_OP(A, T, t, F) OP_##A##_##T,
+
+// typed families are ordered as primitive types, so OP_ADD_CHAR + (pt - PT_CHAR) is OP_ADD for pt
+typedef enum {
+    VM_OPCODES(VM_ENUM_OP, VM_ENUM_TYPED_OP)
+    _OP_END,
+} VmOpcode;
+
+#undef VM_ENUM_OP
+#undef VM_ENUM_TYPED_OP
+
+typedef union {
+    char c;
+    uchar uc;
+    short s;
+    ushort us;
+    int i;
+    uint ui;
+    long l;
+    ulong ul;
+    longlong ll;
+    ulonglong ull;
+    double d;
+    float f;
+
+    size_t st;
+} VmReg;
+
+// variable slot and OP_SMALL_CONST value are (b << 16 | a), OP_CONST is followed by 8 bytes of value
+typedef struct {
+    ushort op;
+    ushort dst, a, b;
+} VmInstr;
+
+_Static_assert(sizeof(VmInstr) == sizeof(ulonglong), "constant must fit in one instruction");
+
+struct VmCode {
+    VmInstr* instrs;
+    Type type;
+    int result;
+};
+
+typedef struct {
+    void* addr;
+    ulonglong old;
+    int size;
+} VmUndo;
+
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+    #define VM_COMPUTED_GOTO
+#endif
+
+// Ret: SUCCESS, ERROR - cannot access to address, all writes are rolled back
+int vmRun(Context* ctx, const VmCode* code, int* changesAnyLValue, ValueExpression* result) {
+    VmReg regs[VM_MAX_REGS];
+    VmUndo undo[VM_MAX_UNDO];
+    int undoCount = 0, changes = 0;
+    const VmInstr* ip = code->instrs;
+
+    #define R(N) regs[ip->N]
+    #define VM_ADDRESS(p, n) void* p = ctxAddress(ctx, R(a).st, (n)); if (p == NULL) goto fault
+    #define VM_SAVE(p, n) {                                     \
+        undo[undoCount].addr = (p);                             \
+        undo[undoCount].size = (n);                             \
+        memcpy(&undo[undoCount].old, (p), (n));                 \
+        undoCount++;                                            \
+    }
+
+#ifdef VM_COMPUTED_GOTO
+    #define VM_LABEL_OP(N) &&L_OP_##N,
+    #define VM_LABEL_TYPED_OP(A, T, t, F) &&L_OP_##A##_##T,
+    static const void* labels[] = { VM_OPCODES(VM_LABEL_OP, VM_LABEL_TYPED_OP) };
+    #undef VM_LABEL_OP
+    #undef VM_LABEL_TYPED_OP
+
+    #define VM_CASE(N) L_OP_##N:
+    #define VM_NEXT() goto *labels[(++ip)->op]
+
+    goto *labels[ip->op];
+#else
+    #define VM_CASE(N) case OP_##N:
+    #define VM_NEXT() ip++; continue
+
+    for (;;) switch (ip->op) {
+#endif
+
+    VM_CASE(END) goto done;
+    VM_CASE(CONST) {
+        memcpy(&R(dst).ull, ip + 1, sizeof(ulonglong));
+        ip++;
+    } VM_NEXT();
+    VM_CASE(SMALL_CONST) R(dst).ull = (uint) ip->b << 16 | ip->a; VM_NEXT();
+    VM_CASE(ADDR_VAR) R(dst).st = ctxPointer(ctx, ctx->vars[(uint) ip->b << 16 | ip->a].data); VM_NEXT();
+
+    #define VM_LOAD(A, W, t, F) VM_CASE(A##_##W) {          \
+        VM_ADDRESS(p, sizeof(t));                           \
+        VmReg v;                                            \
+        v.ull = 0;                                          \
+        memcpy(&v.F, p, sizeof(t));                         \
+        R(dst) = v;                                         \
+    } VM_NEXT();
+
+    #define VM_STORE(A, W, t, F) VM_CASE(A##_##W) {         \
+        VM_ADDRESS(p, sizeof(t));                           \
+        t old;                                              \
+        VM_SAVE(p, sizeof(t));                              \
+        memcpy(&old, p, sizeof(t));                         \
+        if (old != R(b).F) changes = 1;                     \
+        memcpy(p, &R(b).F, sizeof(t));                      \
+    } VM_NEXT();
+
+    #define VM_LOAD_VAR(A, W, t, F) VM_CASE(A##_##W) {      \
+        VmReg v;                                            \
+        v.ull = 0;                                          \
+        memcpy(&v.F, ctx->vars[(uint) ip->b << 16 | ip->a].data, sizeof(t)); \
+        R(dst) = v;                                         \
+    } VM_NEXT();
+
+    VM_WIDTHS(VM_LOAD, LOAD)
+    VM_WIDTHS(VM_LOAD_VAR, LOAD_VAR)
+    VM_WIDTHS(VM_STORE, STORE)
+    VM_STORE(STORE, FLOAT, float, f)
+    VM_STORE(STORE, DOUBLE, double, d)
+
+    VM_CASE(STORE_PTR) {
+        VM_ADDRESS(p, sizeof(size));
+        VM_SAVE(p, sizeof(size));
+        memcpy(p, &R(b).st, sizeof(size));
+    } VM_NEXT();
+
+    #define VM_INC(A, W, t, F, OP1, OP2) VM_CASE(A##_##W) { \
+        VM_ADDRESS(p, sizeof(t));                           \
+        t cur;                                              \
+        VmReg v;                                            \
+        VM_SAVE(p, sizeof(t));                              \
+        memcpy(&cur, p, sizeof(t));                         \
+        v.ull = 0;                                          \
+        v.F = OP1 cur OP2;                                  \
+        memcpy(p, &cur, sizeof(t));                         \
+        R(dst) = v;                                         \
+        changes = 1;                                        \
+    } VM_NEXT();
+
+    #define VM_PRE_INC(A, W, t, F) VM_INC(A, W, t, F, ++, )
+    #define VM_PRE_DEC(A, W, t, F) VM_INC(A, W, t, F, --, )
+    #define VM_POST_INC(A, W, t, F) VM_INC(A, W, t, F, , ++)
+    #define VM_POST_DEC(A, W, t, F) VM_INC(A, W, t, F, , --)
+
+    VM_INC_WIDTHS(VM_PRE_INC, INC)
+    VM_INC_WIDTHS(VM_PRE_DEC, DEC)
+    VM_INC_WIDTHS(VM_POST_INC, P_INC)
+    VM_INC_WIDTHS(VM_POST_DEC, P_DEC)
+
+    // conversions depend only on value, so every value is widened to longlong, ulonglong or double first
+    #define VM_UNARY(N, FROM, TO, EXPR) VM_CASE(N) {        \
+        VmReg v;                                            \
+        v.ull = 0;                                          \
+        v.TO = EXPR R(a).FROM;                              \
+        R(dst) = v;                                         \
+    } VM_NEXT();
+
+    VM_UNARY(SEXT_CHAR, c, ll, (longlong))
+    VM_UNARY(SEXT_SHORT, s, ll, (longlong))
+    VM_UNARY(SEXT_INT, i, ll, (longlong))
+    VM_UNARY(SEXT_LONG, l, ll, (longlong))
+    VM_UNARY(FLOAT_TO_DOUBLE, f, d, (double))
+
+    #define VM_CVT_LL(A, T, t, F) VM_UNARY(A##_##T, ll, F, (t))
+    #define VM_CVT_ULL(A, T, t, F) VM_UNARY(A##_##T, ull, F, (t))
+    #define VM_CVT_D(A, T, t, F) VM_UNARY(A##_##T, d, F, (t))
+
+    VM_TYPES_PTR(VM_CVT_LL, CVT_LL)
+    VM_TYPES_PTR(VM_CVT_ULL, CVT_ULL)
+    VM_TYPES_PTR(VM_CVT_D, CVT_D)
+
+    #define VM_BINARY(N, TO, F, OP) VM_CASE(N) {            \
+        VmReg v;                                            \
+        v.ull = 0;                                          \
+        v.TO = R(a).F OP R(b).F;                            \
+        R(dst) = v;                                         \
+    } VM_NEXT();
+
+    #define VM_ADD(A, T, t, F) VM_BINARY(A##_##T, F, F, +)
+    #define VM_SUB(A, T, t, F) VM_BINARY(A##_##T, F, F, -)
+    #define VM_MUL(A, T, t, F) VM_BINARY(A##_##T, F, F, *)
+    #define VM_DIV(A, T, t, F) VM_BINARY(A##_##T, F, F, /)
+    #define VM_MOD(A, T, t, F) VM_BINARY(A##_##T, F, F, %)
+    #define VM_LSH(A, T, t, F) VM_BINARY(A##_##T, F, F, <<)
+    #define VM_RSH(A, T, t, F) VM_BINARY(A##_##T, F, F, >>)
+    #define VM_EQ(A, T, t, F) VM_BINARY(A##_##T, i, F, ==)
+    #define VM_NEQ(A, T, t, F) VM_BINARY(A##_##T, i, F, !=)
+    #define VM_GR(A, T, t, F) VM_BINARY(A##_##T, i, F, >)
+    #define VM_LR(A, T, t, F) VM_BINARY(A##_##T, i, F, <)
+    #define VM_GRE(A, T, t, F) VM_BINARY(A##_##T, i, F, >=)
+    #define VM_LRE(A, T, t, F) VM_BINARY(A##_##T, i, F, <=)
+    #define VM_NEG(A, T, t, F) VM_UNARY(A##_##T, F, F, -)
+
+    VM_ADD_TYPES(VM_ADD, ADD)
+    VM_ADD_TYPES(VM_SUB, SUB)
+    VM_ADD_TYPES(VM_MUL, MUL)
+    VM_TYPES(VM_DIV, DIV)
+    VM_INT_TYPES(VM_MOD, MOD)
+    VM_SHIFT_TYPES(VM_LSH, LSH)
+    VM_SHIFT_TYPES(VM_RSH, RSH)
+    VM_TYPES_PTR(VM_EQ, EQ)
+    VM_TYPES_PTR(VM_NEQ, NEQ)
+    VM_TYPES_PTR(VM_GR, GR)
+    VM_TYPES_PTR(VM_LR, LR)
+    VM_TYPES_PTR(VM_GRE, GRE)
+    VM_TYPES_PTR(VM_LRE, LRE)
+    VM_NEG_TYPES(VM_NEG, NEG)
+
+    VM_BINARY(BAND, st, st, &)
+    VM_BINARY(BOR, st, st, |)
+    VM_BINARY(XOR, st, st, ^)
+
+    VM_CASE(LAND) {
+        VmReg v;
+        v.ull = 0;
+        v.i = (R(a).ull != 0) && (R(b).ull != 0);
+        R(dst) = v;
+    } VM_NEXT();
+
+    VM_CASE(LOR) {
+        VmReg v;
+        v.ull = 0;
+        v.i = (R(a).ull != 0) || (R(b).ull != 0);
+        R(dst) = v;
+    } VM_NEXT();
+
+    VM_CASE(LNOT) {
+        VmReg v;
+        v.ull = 0;
+        v.i = R(a).ull == 0;
+        R(dst) = v;
+    } VM_NEXT();
+
+    // pointer factor is width of the opcode
+    #define VM_BNOT(A, W, t, F) VM_UNARY(A##_##W, F, F, (t) ~)
+    #define VM_PTR_ADD(A, W, t, F) VM_CASE(A##_##W) R(dst).st = R(a).st + R(b).st * sizeof(t); VM_NEXT();
+    #define VM_PTR_SUB(A, W, t, F) VM_CASE(A##_##W) R(dst).st = R(a).st - R(b).st * sizeof(t); VM_NEXT();
+
+    VM_WIDTHS(VM_BNOT, BNOT)
+    VM_WIDTHS(VM_PTR_ADD, PTR_ADD)
+    VM_WIDTHS(VM_PTR_SUB, PTR_SUB)
+
+    // compound assignment in place, b has type of lvalue. Address is checked once and the
+    // change is detected as by store
+    #define VM_RMW(N, t, F, OP) VM_CASE(N) {                \
+        VM_ADDRESS(p, sizeof(t));                           \
+        t old;                                              \
+        VmReg v;                                            \
+        VM_SAVE(p, sizeof(t));                              \
+        memcpy(&old, p, sizeof(t));                         \
+        v.ull = 0;                                          \
+        v.F = old OP R(b).F;                                \
+        if (v.F != old) changes = 1;                        \
+        memcpy(p, &v.F, sizeof(t));                         \
+        R(dst) = v;                                         \
+    } VM_NEXT();
+
+    #define VM_ADD_AT(A, T, t, F) VM_RMW(A##_##T, t, F, +)
+    #define VM_SUB_AT(A, T, t, F) VM_RMW(A##_##T, t, F, -)
+    #define VM_MUL_AT(A, T, t, F) VM_RMW(A##_##T, t, F, *)
+    #define VM_DIV_AT(A, T, t, F) VM_RMW(A##_##T, t, F, /)
+    #define VM_MOD_AT(A, T, t, F) VM_RMW(A##_##T, t, F, %)
+    #define VM_LSH_AT(A, T, t, F) VM_RMW(A##_##T, t, F, <<)
+    #define VM_RSH_AT(A, T, t, F) VM_RMW(A##_##T, t, F, >>)
+    #define VM_BAND_AT(A, W, t, F) VM_RMW(A##_##W, t, F, &)
+    #define VM_BOR_AT(A, W, t, F) VM_RMW(A##_##W, t, F, |)
+    #define VM_XOR_AT(A, W, t, F) VM_RMW(A##_##W, t, F, ^)
+
+    VM_ADD_TYPES(VM_ADD_AT, ADD_AT)
+    VM_ADD_TYPES(VM_SUB_AT, SUB_AT)
+    VM_ADD_TYPES(VM_MUL_AT, MUL_AT)
+    VM_TYPES(VM_DIV_AT, DIV_AT)
+    VM_INT_TYPES(VM_MOD_AT, MOD_AT)
+    VM_SHIFT_TYPES(VM_LSH_AT, LSH_AT)
+    VM_SHIFT_TYPES(VM_RSH_AT, RSH_AT)
+    VM_WIDTHS(VM_BAND_AT, BAND_AT)
+    VM_WIDTHS(VM_BOR_AT, BOR_AT)
+    VM_WIDTHS(VM_XOR_AT, XOR_AT)
+
+#ifndef VM_COMPUTED_GOTO
+        default:
+            error("Bad opcode %d", ip->op);
+            goto fault;
+    }
+#endif
+
+fault:
+    while (undoCount > 0) {
+        undoCount--;
+        memcpy(undo[undoCount].addr, &undo[undoCount].old, undo[undoCount].size);
+    }
+    return ERROR;
+
+done:
+    if (changes) *changesAnyLValue = 1;
+    result->type = code->type;
+    result->ull = regs[code->result].ull;
+    return SUCCESS;
+
+    #undef R
+    #undef VM_ADDRESS
+    #undef VM_SAVE
+    #undef VM_CASE
+    #undef VM_NEXT
+    #undef VM_LOAD
+    #undef VM_LOAD_VAR
+    #undef VM_STORE
+    #undef VM_INC
+    #undef VM_PRE_INC
+    #undef VM_PRE_DEC
+    #undef VM_POST_INC
+    #undef VM_POST_DEC
+    #undef VM_UNARY
+    #undef VM_CVT_LL
+    #undef VM_CVT_ULL
+    #undef VM_CVT_D
+    #undef VM_BINARY
+    #undef VM_ADD
+    #undef VM_SUB
+    #undef VM_MUL
+    #undef VM_DIV
+    #undef VM_MOD
+    #undef VM_LSH
+    #undef VM_RSH
+    #undef VM_EQ
+    #undef VM_NEQ
+    #undef VM_GR
+    #undef VM_LR
+    #undef VM_GRE
+    #undef VM_LRE
+    #undef VM_NEG
+    #undef VM_BNOT
+    #undef VM_RMW
+    #undef VM_ADD_AT
+    #undef VM_SUB_AT
+    #undef VM_MUL_AT
+    #undef VM_DIV_AT
+    #undef VM_MOD_AT
+    #undef VM_LSH_AT
+    #undef VM_RSH_AT
+    #undef VM_BAND_AT
+    #undef VM_BOR_AT
+    #undef VM_XOR_AT
+    #undef VM_PTR_ADD
+    #undef VM_PTR_SUB
+}
+
+// Runs of parameter sets are executed VM_LANES at once by the same code. Every register and
+// variable has a value per lane, lanes of one value are side by side, so an instruction is a loop
+// over lanes, and the AVX2 kernel does common binary operators by vectors. Only code without
+// pointers runs by lanes: address of variable is its slot and it is used only by memory
+// instructions, so lanes never fault
+#define VM_LANES 8
+
+struct ParamLanes {
+    VmReg regs[VM_MAX_REGS][VM_LANES];
+    VmReg results[VM_LANES];
+    VmReg* vars;             // VM_LANES values per slot
+    ValueExpression* params; // VM_LANES initial values per slot, void - not bound
+};
+
+// operands of instructions for lanes, LO_NO - instruction works with pointers, code doesn't run by lanes
+typedef enum {
+    LO_NO,
+    LO_NONE,
+    LO_CONST,    // followed by value
+    LO_ADDR_VAR, // address of variable, it is used only by LO_LOAD, LO_STORE, LO_RMW and LO_INC
+    LO_A,
+    LO_AB,
+    LO_DIV,      // a, b - integer division which may trap
+    LO_LOAD,     // a - address
+    LO_STORE,    // a - address, b - value, no result
+    LO_RMW,      // a - address, b - value
+    LO_INC,      // a - address
+} VmLaneOperands;
+
+#define VM_LO_A(A, T, t, F) [OP_##A##_##T] = LO_A,
+#define VM_LO_AB(A, T, t, F) [OP_##A##_##T] = LO_AB,
+#define VM_LO_DIV(A, T, t, F) [OP_##A##_##T] = LO_DIV,
+#define VM_LO_LOAD(A, T, t, F) [OP_##A##_##T] = LO_LOAD,
+#define VM_LO_STORE(A, T, t, F) [OP_##A##_##T] = LO_STORE,
+#define VM_LO_RMW(A, T, t, F) [OP_##A##_##T] = LO_RMW,
+#define VM_LO_INC(A, T, t, F) [OP_##A##_##T] = LO_INC,
+
+// pointer families are left out: CVT_*_PTR, comparisons of pointers, STORE_PTR, PTR_ADD and PTR_SUB
+const uchar vmLaneOperands[_OP_END] = {
+    [OP_END] = LO_NONE, [OP_CONST] = LO_CONST, [OP_SMALL_CONST] = LO_NONE, [OP_ADDR_VAR] = LO_ADDR_VAR,
+    [OP_LOAD_VAR_8 ... OP_LOAD_VAR_64] = LO_NONE,
+    VM_WIDTHS(VM_LO_LOAD, LOAD) VM_WIDTHS(VM_LO_STORE, STORE)
+    [OP_STORE_FLOAT] = LO_STORE, [OP_STORE_DOUBLE] = LO_STORE,
+    VM_INC_WIDTHS(VM_LO_INC, INC) VM_INC_WIDTHS(VM_LO_INC, DEC)
+    VM_INC_WIDTHS(VM_LO_INC, P_INC) VM_INC_WIDTHS(VM_LO_INC, P_DEC)
+    [OP_SEXT_CHAR ... OP_FLOAT_TO_DOUBLE] = LO_A,
+    VM_TYPES(VM_LO_A, CVT_LL) VM_TYPES(VM_LO_A, CVT_ULL) VM_TYPES(VM_LO_A, CVT_D)
+    VM_ADD_TYPES(VM_LO_AB, ADD) VM_ADD_TYPES(VM_LO_AB, SUB) VM_ADD_TYPES(VM_LO_AB, MUL)
+    VM_INT_TYPES(VM_LO_DIV, DIV) [OP_DIV_FLOAT] = LO_AB, [OP_DIV_DOUBLE] = LO_AB, VM_INT_TYPES(VM_LO_DIV, MOD)
+    VM_SHIFT_TYPES(VM_LO_AB, LSH) VM_SHIFT_TYPES(VM_LO_AB, RSH)
+    VM_TYPES(VM_LO_AB, EQ) VM_TYPES(VM_LO_AB, NEQ) VM_TYPES(VM_LO_AB, GR)
+    VM_TYPES(VM_LO_AB, LR) VM_TYPES(VM_LO_AB, GRE) VM_TYPES(VM_LO_AB, LRE)
+    VM_NEG_TYPES(VM_LO_A, NEG)
+    [OP_BAND ... OP_LOR] = LO_AB, [OP_LNOT] = LO_A,
+    VM_WIDTHS(VM_LO_A, BNOT)
+    VM_ADD_TYPES(VM_LO_RMW, ADD_AT) VM_ADD_TYPES(VM_LO_RMW, SUB_AT) VM_ADD_TYPES(VM_LO_RMW, MUL_AT)
+    VM_TYPES(VM_LO_RMW, DIV_AT) VM_INT_TYPES(VM_LO_RMW, MOD_AT)
+    VM_SHIFT_TYPES(VM_LO_RMW, LSH_AT) VM_SHIFT_TYPES(VM_LO_RMW, RSH_AT)
+    VM_WIDTHS(VM_LO_RMW, BAND_AT) VM_WIDTHS(VM_LO_RMW, BOR_AT) VM_WIDTHS(VM_LO_RMW, XOR_AT)
+};
+
+#undef VM_LO_A
+#undef VM_LO_AB
+#undef VM_LO_DIV
+#undef VM_LO_LOAD
+#undef VM_LO_STORE
+#undef VM_LO_RMW
+#undef VM_LO_INC
+
+// code can run by lanes when it has no pointer values. Pure code doesn't change variables and
+// doesn't divide integers, it may be run in lanes where scalar run doesn't run it
+// Ret: 1 - code runs by lanes, 0 - it doesn't
+int vmIsLaneCode(const VmCode* code, int isPure) {
+    uchar isAddress[VM_MAX_REGS] = {0};
+
+    if (code->type.pLevel != 0) return 0;
+    for (const VmInstr* ip = code->instrs; ip->op != OP_END; ip++) {
+        VmLaneOperands operands = vmLaneOperands[ip->op];
+
+        switch (operands) {
+            case LO_NO:
+                return 0;
+            case LO_A:
+                if (isAddress[ip->a]) return 0;
+                break;
+            case LO_DIV:
+                if (isPure) return 0;
+                // fall through
+            case LO_AB:
+                if (isAddress[ip->a] || isAddress[ip->b]) return 0;
+                break;
+            case LO_LOAD:
+                if (!isAddress[ip->a]) return 0;
+                break;
+            case LO_STORE:
+            case LO_RMW:
+                if (isPure || !isAddress[ip->a] || isAddress[ip->b]) return 0;
+                break;
+            case LO_INC:
+                if (isPure || !isAddress[ip->a]) return 0;
+                break;
+            default:
+                break;
+        }
+        if (operands != LO_STORE) isAddress[ip->dst] = operands == LO_ADDR_VAR;
+        if (operands == LO_CONST) ip++;
+    }
+    return !isAddress[code->result];
+}
+
+// the same loop is compiled for every target of lane kernels
+static inline __attribute__((always_inline))
+void vmRunLanesBody(ParamLanes* lanes, const VmCode* code, uchar* changes,
+                    int (*vecBinary)(ParamLanes* lanes, const VmInstr* ip)) {
+    #define LANE_LOOP for (int l = 0; l < VM_LANES; l++)
+    #define LANE_VAR(slot) (lanes->vars + (size_t) (slot) * VM_LANES)
+    // variable of memory instruction, its address is slot
+    #define LANE_MEM VmReg* m = LANE_VAR(R(a)[0].st)
+    // row of register N, operands which are not registers are never read by it
+    #define R(N) lanes->regs[ip->N]
+
+    for (const VmInstr* ip = code->instrs; ip->op != OP_END; ip++) {
+        if (vecBinary != NULL && vecBinary(lanes, ip)) continue;
+        switch (ip->op) {
+            case OP_CONST: {
+                ulonglong value;
+                memcpy(&value, ip + 1, sizeof(value));
+                LANE_LOOP R(dst)[l].ull = value;
+                ip++;
+                break;
+            }
+            case OP_SMALL_CONST:
+                LANE_LOOP R(dst)[l].ull = (uint) ip->b << 16 | ip->a;
+                break;
+            case OP_ADDR_VAR:
+                R(dst)[0].st = (uint) ip->b << 16 | ip->a;
+                break;
+
+            #define LANE_LOAD_VAR(A, W, t, F) case OP_##A##_##W: {              \
+                const VmReg* v = LANE_VAR((uint) ip->b << 16 | ip->a);          \
+                LANE_LOOP { VmReg r; r.ull = 0; r.F = v[l].F; R(dst)[l] = r; }  \
+                break;                                                          \
+            }
+            #define LANE_LOAD(A, W, t, F) case OP_##A##_##W: {                  \
+                LANE_MEM;                                                       \
+                LANE_LOOP { VmReg r; r.ull = 0; r.F = m[l].F; R(dst)[l] = r; }  \
+                break;                                                          \
+            }
+            #define LANE_STORE(A, W, t, F) case OP_##A##_##W: {                 \
+                LANE_MEM;                                                       \
+                LANE_LOOP {                                                     \
+                    changes[l] |= m[l].F != R(b)[l].F;                          \
+                    m[l].F = R(b)[l].F;                                         \
+                }                                                               \
+                break;                                                          \
+            }
+
+            VM_WIDTHS(LANE_LOAD_VAR, LOAD_VAR)
+            VM_WIDTHS(LANE_LOAD, LOAD)
+            VM_WIDTHS(LANE_STORE, STORE)
+            LANE_STORE(STORE, FLOAT, float, f)
+            LANE_STORE(STORE, DOUBLE, double, d)
+
+            #define LANE_INC(A, W, t, F, OP1, OP2) case OP_##A##_##W: {         \
+                LANE_MEM;                                                       \
+                LANE_LOOP {                                                     \
+                    t cur = m[l].F;                                             \
+                    VmReg r;                                                    \
+                    r.ull = 0;                                                  \
+                    r.F = OP1 cur OP2;                                          \
+                    m[l].F = cur;                                               \
+                    R(dst)[l] = r;                                              \
+                    changes[l] = 1;                                             \
+                }                                                               \
+                break;                                                          \
+            }
+
+            #define LANE_PRE_INC(A, W, t, F) LANE_INC(A, W, t, F, ++, )
+            #define LANE_PRE_DEC(A, W, t, F) LANE_INC(A, W, t, F, --, )
+            #define LANE_POST_INC(A, W, t, F) LANE_INC(A, W, t, F, , ++)
+            #define LANE_POST_DEC(A, W, t, F) LANE_INC(A, W, t, F, , --)
+
+            VM_INC_WIDTHS(LANE_PRE_INC, INC)
+            VM_INC_WIDTHS(LANE_PRE_DEC, DEC)
+            VM_INC_WIDTHS(LANE_POST_INC, P_INC)
+            VM_INC_WIDTHS(LANE_POST_DEC, P_DEC)
+
+            #define LANE_UNARY(N, FROM, TO, EXPR) case OP_##N:                  \
+                LANE_LOOP {                                                     \
+                    VmReg r;                                                    \
+                    r.ull = 0;                                                  \
+                    r.TO = EXPR R(a)[l].FROM;                                   \
+                    R(dst)[l] = r;                                              \
+                }                                                               \
+                break;
+
+            LANE_UNARY(SEXT_CHAR, c, ll, (longlong))
+            LANE_UNARY(SEXT_SHORT, s, ll, (longlong))
+            LANE_UNARY(SEXT_INT, i, ll, (longlong))
+            LANE_UNARY(SEXT_LONG, l, ll, (longlong))
+            LANE_UNARY(FLOAT_TO_DOUBLE, f, d, (double))
+
+            #define LANE_CVT_LL(A, T, t, F) LANE_UNARY(A##_##T, ll, F, (t))
+            #define LANE_CVT_ULL(A, T, t, F) LANE_UNARY(A##_##T, ull, F, (t))
+            #define LANE_CVT_D(A, T, t, F) LANE_UNARY(A##_##T, d, F, (t))
+
+            VM_TYPES(LANE_CVT_LL, CVT_LL)
+            VM_TYPES(LANE_CVT_ULL, CVT_ULL)
+            VM_TYPES(LANE_CVT_D, CVT_D)
+
+            #define LANE_BINARY(N, TO, F, OP) case OP_##N:                      \
+                LANE_LOOP {                                                     \
+                    VmReg r;                                                    \
+                    r.ull = 0;                                                  \
+                    r.TO = R(a)[l].F OP R(b)[l].F;                              \
+                    R(dst)[l] = r;                                              \
+                }                                                               \
+                break;
+
+            #define LANE_ADD(A, T, t, F) LANE_BINARY(A##_##T, F, F, +)
+            #define LANE_SUB(A, T, t, F) LANE_BINARY(A##_##T, F, F, -)
+            #define LANE_MUL(A, T, t, F) LANE_BINARY(A##_##T, F, F, *)
+            #define LANE_DIV(A, T, t, F) LANE_BINARY(A##_##T, F, F, /)
+            #define LANE_MOD(A, T, t, F) LANE_BINARY(A##_##T, F, F, %)
+            #define LANE_LSH(A, T, t, F) LANE_BINARY(A##_##T, F, F, <<)
+            #define LANE_RSH(A, T, t, F) LANE_BINARY(A##_##T, F, F, >>)
+            #define LANE_EQ(A, T, t, F) LANE_BINARY(A##_##T, i, F, ==)
+            #define LANE_NEQ(A, T, t, F) LANE_BINARY(A##_##T, i, F, !=)
+            #define LANE_GR(A, T, t, F) LANE_BINARY(A##_##T, i, F, >)
+            #define LANE_LR(A, T, t, F) LANE_BINARY(A##_##T, i, F, <)
+            #define LANE_GRE(A, T, t, F) LANE_BINARY(A##_##T, i, F, >=)
+            #define LANE_LRE(A, T, t, F) LANE_BINARY(A##_##T, i, F, <=)
+            #define LANE_NEG(A, T, t, F) LANE_UNARY(A##_##T, F, F, -)
+
+            VM_ADD_TYPES(LANE_ADD, ADD)
+            VM_ADD_TYPES(LANE_SUB, SUB)
+            VM_ADD_TYPES(LANE_MUL, MUL)
+            VM_TYPES(LANE_DIV, DIV)
+            VM_INT_TYPES(LANE_MOD, MOD)
+            VM_SHIFT_TYPES(LANE_LSH, LSH)
+            VM_SHIFT_TYPES(LANE_RSH, RSH)
+            VM_TYPES(LANE_EQ, EQ)
+            VM_TYPES(LANE_NEQ, NEQ)
+            VM_TYPES(LANE_GR, GR)
+            VM_TYPES(LANE_LR, LR)
+            VM_TYPES(LANE_GRE, GRE)
+            VM_TYPES(LANE_LRE, LRE)
+            VM_NEG_TYPES(LANE_NEG, NEG)
+
+            LANE_BINARY(BAND, st, st, &)
+            LANE_BINARY(BOR, st, st, |)
+            LANE_BINARY(XOR, st, st, ^)
+            LANE_BINARY(LAND, i, ull, &&)
+            LANE_BINARY(LOR, i, ull, ||)
+
+            case OP_LNOT:
+                LANE_LOOP { VmReg r; r.ull = 0; r.i = R(a)[l].ull == 0; R(dst)[l] = r; }
+                break;
+
+            #define LANE_BNOT(A, W, t, F) LANE_UNARY(A##_##W, F, F, (t) ~)
+
+            VM_WIDTHS(LANE_BNOT, BNOT)
+
+            #define LANE_RMW(N, t, F, OP) case OP_##N: {                        \
+                LANE_MEM;                                                       \
+                LANE_LOOP {                                                     \
+                    t old = m[l].F;                                             \
+                    VmReg r;                                                    \
+                    r.ull = 0;                                                  \
+                    r.F = old OP R(b)[l].F;                                     \
+                    changes[l] |= r.F != old;                                   \
+                    m[l].F = r.F;                                               \
+                    R(dst)[l] = r;                                              \
+                }                                                               \
+                break;                                                          \
+            }
+
+            #define LANE_ADD_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, +)
+            #define LANE_SUB_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, -)
+            #define LANE_MUL_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, *)
+            #define LANE_DIV_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, /)
+            #define LANE_MOD_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, %)
+            #define LANE_LSH_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, <<)
+            #define LANE_RSH_AT(A, T, t, F) LANE_RMW(A##_##T, t, F, >>)
+            #define LANE_BAND_AT(A, W, t, F) LANE_RMW(A##_##W, t, F, &)
+            #define LANE_BOR_AT(A, W, t, F) LANE_RMW(A##_##W, t, F, |)
+            #define LANE_XOR_AT(A, W, t, F) LANE_RMW(A##_##W, t, F, ^)
+
+            VM_ADD_TYPES(LANE_ADD_AT, ADD_AT)
+            VM_ADD_TYPES(LANE_SUB_AT, SUB_AT)
+            VM_ADD_TYPES(LANE_MUL_AT, MUL_AT)
+            VM_TYPES(LANE_DIV_AT, DIV_AT)
+            VM_INT_TYPES(LANE_MOD_AT, MOD_AT)
+            VM_SHIFT_TYPES(LANE_LSH_AT, LSH_AT)
+            VM_SHIFT_TYPES(LANE_RSH_AT, RSH_AT)
+            VM_WIDTHS(LANE_BAND_AT, BAND_AT)
+            VM_WIDTHS(LANE_BOR_AT, BOR_AT)
+            VM_WIDTHS(LANE_XOR_AT, XOR_AT)
+
+            // code is checked by vmIsLaneCode
+            default:
+                break;
+        }
+    }
+    memcpy(lanes->results, lanes->regs[code->result], sizeof(lanes->results));
+
+    #undef LANE_LOOP
+    #undef LANE_VAR
+    #undef LANE_MEM
+    #undef R
+    #undef LANE_LOAD_VAR
+    #undef LANE_LOAD
+    #undef LANE_STORE
+    #undef LANE_INC
+    #undef LANE_PRE_INC
+    #undef LANE_PRE_DEC
+    #undef LANE_POST_INC
+    #undef LANE_POST_DEC
+    #undef LANE_UNARY
+    #undef LANE_CVT_LL
+    #undef LANE_CVT_ULL
+    #undef LANE_CVT_D
+    #undef LANE_BINARY
+    #undef LANE_ADD
+    #undef LANE_SUB
+    #undef LANE_MUL
+    #undef LANE_DIV
+    #undef LANE_MOD
+    #undef LANE_LSH
+    #undef LANE_RSH
+    #undef LANE_EQ
+    #undef LANE_NEQ
+    #undef LANE_GR
+    #undef LANE_LR
+    #undef LANE_GRE
+    #undef LANE_LRE
+    #undef LANE_NEG
+    #undef LANE_BNOT
+    #undef LANE_RMW
+    #undef LANE_ADD_AT
+    #undef LANE_SUB_AT
+    #undef LANE_MUL_AT
+    #undef LANE_DIV_AT
+    #undef LANE_MOD_AT
+    #undef LANE_LSH_AT
+    #undef LANE_RSH_AT
+    #undef LANE_BAND_AT
+    #undef LANE_BOR_AT
+    #undef LANE_XOR_AT
+}
+
+// lane kernels: code checked by vmIsLaneCode is run for all lanes, results are in lanes->results,
+// changes[lane] is set when the lane changes a variable. The best one is selected by selectLaneKernels
+void vmRunLanesScalar(ParamLanes* lanes, const VmCode* code, uchar* changes) {
+    vmRunLanesBody(lanes, code, changes, NULL);
+}
+
+#ifdef HAS_X86_KERNELS
+
+// binary operators of 32 and 64 bit types, 4 lanes per vector. Registers are zero extended, so
+// 32 bit operators leave zeros in the high halves. Floating ones are taken only when scalar code
+// uses SSE math too, otherwise the rounding may differ
+// Ret: 1 - the instruction is executed, 0 - it's left to the lane loop
+__attribute__((target("avx2")))
+static inline int vmLaneBinaryAvx2(ParamLanes* lanes, const VmInstr* ip) {
+    #define VEC_CASE(N, EXPR) case OP_##N: {                                    \
+        const __m256i* va = (const __m256i*) lanes->regs[ip->a];                \
+        const __m256i* vb = (const __m256i*) lanes->regs[ip->b];                \
+        __m256i* vd = (__m256i*) lanes->regs[ip->dst];                          \
+        for (size_t k = 0; k < VM_LANES * sizeof(VmReg) / sizeof(__m256i); k++) {\
+            __m256i a = _mm256_loadu_si256(va + k);                             \
+            __m256i b = _mm256_loadu_si256(vb + k);                             \
+            _mm256_storeu_si256(vd + k, EXPR);                                  \
+        }                                                                       \
+        return 1;                                                               \
+    }
+    // signed and unsigned variants of an operator which doesn't depend on the sign
+    #define VEC_CASE2(N, T, EXPR) VEC_CASE(N##_##T, EXPR) VEC_CASE(N##_U##T, EXPR)
+    // long is one of the integer widths
+    #define VEC_LONG(OP) (sizeof(long) == 8 ? _mm256_##OP##_epi64(a, b) : _mm256_##OP##_epi32(a, b))
+    // comparisons give -1 per lane, registers need 1
+    #define VEC_TRUE(MASK) _mm256_and_si256(MASK, _mm256_set1_epi64x(1))
+    #define VEC_FALSE(MASK) _mm256_andnot_si256(MASK, _mm256_set1_epi64x(1))
+    #define VEC_PS(OP) _mm256_castps_si256(_mm256_##OP##_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)))
+    #define VEC_PD(OP) _mm256_castpd_si256(_mm256_##OP##_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b)))
+    #define VEC_CMP_PS(P) _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), P))
+    #define VEC_CMP_PD(P) _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), P))
+
+    switch (ip->op) {
+        VEC_CASE2(ADD, INT, _mm256_add_epi32(a, b))
+        VEC_CASE2(ADD, LONG, VEC_LONG(add))
+        VEC_CASE2(ADD, LONGLONG, _mm256_add_epi64(a, b))
+        VEC_CASE2(SUB, INT, _mm256_sub_epi32(a, b))
+        VEC_CASE2(SUB, LONG, VEC_LONG(sub))
+        VEC_CASE2(SUB, LONGLONG, _mm256_sub_epi64(a, b))
+        VEC_CASE2(MUL, INT, _mm256_mullo_epi32(a, b))
+
+        VEC_CASE2(EQ, INT, VEC_TRUE(_mm256_cmpeq_epi32(a, b)))
+        VEC_CASE2(EQ, LONG, VEC_TRUE(VEC_LONG(cmpeq)))
+        VEC_CASE2(EQ, LONGLONG, VEC_TRUE(_mm256_cmpeq_epi64(a, b)))
+        VEC_CASE2(NEQ, INT, VEC_FALSE(_mm256_cmpeq_epi32(a, b)))
+        VEC_CASE2(NEQ, LONG, VEC_FALSE(VEC_LONG(cmpeq)))
+        VEC_CASE2(NEQ, LONGLONG, VEC_FALSE(_mm256_cmpeq_epi64(a, b)))
+        VEC_CASE(GR_INT, VEC_TRUE(_mm256_cmpgt_epi32(a, b)))
+        VEC_CASE(GR_LONGLONG, VEC_TRUE(_mm256_cmpgt_epi64(a, b)))
+        VEC_CASE(LRE_INT, VEC_FALSE(_mm256_cmpgt_epi32(a, b)))
+        VEC_CASE(LRE_LONGLONG, VEC_FALSE(_mm256_cmpgt_epi64(a, b)))
+        VEC_CASE(LR_INT, VEC_TRUE(_mm256_cmpgt_epi32(b, a)))
+        VEC_CASE(LR_LONGLONG, VEC_TRUE(_mm256_cmpgt_epi64(b, a)))
+        VEC_CASE(GRE_INT, VEC_FALSE(_mm256_cmpgt_epi32(b, a)))
+        VEC_CASE(GRE_LONGLONG, VEC_FALSE(_mm256_cmpgt_epi64(b, a)))
+
+        VEC_CASE(BAND, _mm256_and_si256(a, b))
+        VEC_CASE(BOR, _mm256_or_si256(a, b))
+        VEC_CASE(XOR, _mm256_xor_si256(a, b))
+
+#ifdef __SSE2_MATH__
+        VEC_CASE(ADD_FLOAT, VEC_PS(add))
+        VEC_CASE(SUB_FLOAT, VEC_PS(sub))
+        VEC_CASE(MUL_FLOAT, VEC_PS(mul))
+        VEC_CASE(ADD_DOUBLE, VEC_PD(add))
+        VEC_CASE(SUB_DOUBLE, VEC_PD(sub))
+        VEC_CASE(MUL_DOUBLE, VEC_PD(mul))
+        VEC_CASE(DIV_DOUBLE, VEC_PD(div))
+        VEC_CASE(EQ_FLOAT, VEC_TRUE(VEC_CMP_PS(_CMP_EQ_OQ)))
+        VEC_CASE(NEQ_FLOAT, VEC_TRUE(VEC_CMP_PS(_CMP_NEQ_UQ)))
+        VEC_CASE(GR_FLOAT, VEC_TRUE(VEC_CMP_PS(_CMP_GT_OQ)))
+        VEC_CASE(LR_FLOAT, VEC_TRUE(VEC_CMP_PS(_CMP_LT_OQ)))
+        VEC_CASE(GRE_FLOAT, VEC_TRUE(VEC_CMP_PS(_CMP_GE_OQ)))
+        VEC_CASE(LRE_FLOAT, VEC_TRUE(VEC_CMP_PS(_CMP_LE_OQ)))
+        VEC_CASE(EQ_DOUBLE, VEC_TRUE(VEC_CMP_PD(_CMP_EQ_OQ)))
+        VEC_CASE(NEQ_DOUBLE, VEC_TRUE(VEC_CMP_PD(_CMP_NEQ_UQ)))
+        VEC_CASE(GR_DOUBLE, VEC_TRUE(VEC_CMP_PD(_CMP_GT_OQ)))
+        VEC_CASE(LR_DOUBLE, VEC_TRUE(VEC_CMP_PD(_CMP_LT_OQ)))
+        VEC_CASE(GRE_DOUBLE, VEC_TRUE(VEC_CMP_PD(_CMP_GE_OQ)))
+        VEC_CASE(LRE_DOUBLE, VEC_TRUE(VEC_CMP_PD(_CMP_LE_OQ)))
+#endif
+        default:
+            return 0;
+    }
+
+    #undef VEC_CASE
+    #undef VEC_CASE2
+    #undef VEC_LONG
+    #undef VEC_TRUE
+    #undef VEC_FALSE
+    #undef VEC_PS
+    #undef VEC_PD
+    #undef VEC_CMP_PS
+    #undef VEC_CMP_PD
+}
+
+__attribute__((target("avx2")))
+void vmRunLanesAvx2(ParamLanes* lanes, const VmCode* code, uchar* changes) {
+    vmRunLanesBody(lanes, code, changes, vmLaneBinaryAvx2);
+}
+
+#endif
+
+void (*vmRunLanes)(ParamLanes* lanes, const VmCode* code, uchar* changes) = vmRunLanesScalar;
+
+// must be called before threads start
+void selectLaneKernels() {
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) vmRunLanes = vmRunLanesAvx2;
+#endif
+}
+
+typedef struct {
+    VmInstr* instrs;
+    int count;
+    int capacity;
+    int regTop;
+    int storeCount;
+    int mallocFailed;
+    const ExprPool* exprs;
+} VmCompiler;
+
+// Ret: SUCCESS, MALLOC_ERROR
+int vmEmit(VmCompiler* c, VmOpcode op, int dst, int a, int b) {
+    VmInstr* in;
+
+    if (c->count == c->capacity) {
+        int newCapacity = c->capacity == 0 ? VM_CODE_START_CAP : c->capacity * ARRAY_GROW_FACTOR;
+        VmInstr* newInstrs = (VmInstr*) realloc(c->instrs, newCapacity * sizeof(VmInstr));
+
+        if (newInstrs == NULL) {
+            c->mallocFailed = 1;
+            return MALLOC_ERROR;
+        }
+        c->instrs = newInstrs;
+        c->capacity = newCapacity;
+    }
+
+    in = &c->instrs[c->count++];
+    in->op = op;
+    in->dst = dst;
+    in->a = a;
+    in->b = b;
+    return SUCCESS;
+}
+
+// wide value takes place of the next instruction
+// Ret: SUCCESS, MALLOC_ERROR
+int vmEmitConst(VmCompiler* c, int dst, ulonglong value) {
+    if (value <= 0xFFFFFFFF) return vmEmit(c, OP_SMALL_CONST, dst, value & 0xFFFF, value >> 16);
+    if (vmEmit(c, OP_CONST, dst, 0, 0) != SUCCESS) return MALLOC_ERROR;
+    if (vmEmit(c, OP_END, 0, 0, 0) != SUCCESS) return MALLOC_ERROR;
+    memcpy(&c->instrs[c->count - 1], &value, sizeof(value));
+    return SUCCESS;
+}
+
+// Ret: -1 - no free registers, register - success
+int vmAllocReg(VmCompiler* c) {
+    if (c->regTop == VM_MAX_REGS) return -1;
+    return c->regTop++;
+}
+
+// families with widths are ordered 1, 2, 4, 8 bytes
+VmOpcode vmWidthOp(VmOpcode first, int bytes) {
+    switch (bytes) {
+        case 1: return first;
+        case 2: return first + 1;
+        case 4: return first + 2;
+        default: return first + 3;
+    }
+}
+
+// from and to are primitive types or VM_PTR_TYPE, register is converted in place
+// Ret: SUCCESS, MALLOC_ERROR
+int vmEmitConvert(VmCompiler* c, int reg, int from, int to) {
+    VmOpcode widen = _OP_END, narrow;
+    int wide;
+
+    if (from == to) return SUCCESS;
+
+    switch (from) {
+        case PT_CHAR: widen = OP_SEXT_CHAR; wide = PT_LONGLONG; break;
+        case PT_SHORT: widen = OP_SEXT_SHORT; wide = PT_LONGLONG; break;
+        case PT_INT: widen = OP_SEXT_INT; wide = PT_LONGLONG; break;
+        case PT_LONG:
+            if (sizeof(long) < sizeof(longlong)) widen = OP_SEXT_LONG;
+            wide = PT_LONGLONG;
+            break;
+        case PT_LONGLONG: wide = PT_LONGLONG; break;
+        case PT_FLOAT: widen = OP_FLOAT_TO_DOUBLE; wide = PT_DOUBLE; break;
+        case PT_DOUBLE: wide = PT_DOUBLE; break;
+        default: wide = PT_ULONGLONG; break; // unsigned values and pointers have zero upper bytes
+    }
+    if (widen != _OP_END && vmEmit(c, widen, reg, reg, 0) != SUCCESS) return MALLOC_ERROR;
+
+    if (wide == to) return SUCCESS;
+    // 64-bit integers and pointers have the same bits
+    if (wide != PT_DOUBLE && (to == PT_LONGLONG || to == PT_ULONGLONG || to == VM_PTR_TYPE)) return SUCCESS;
+
+    switch (wide) {
+        case PT_LONGLONG: narrow = OP_CVT_LL_CHAR; break;
+        case PT_ULONGLONG: narrow = OP_CVT_ULL_CHAR; break;
+        default: narrow = OP_CVT_D_CHAR; break;
+    }
+    return vmEmit(c, narrow + (to - PT_CHAR), reg, reg, 0);
+}
+
+// castTo for register, types are checked by resolveStatement
+// Ret: SUCCESS, MALLOC_ERROR
+int vmEmitCast(VmCompiler* c, int reg, Type from, Type to) {
+    if (to.pLevel != 0) {
+        return from.pLevel != 0 ? SUCCESS : vmEmitConvert(c, reg, from.pt, VM_PTR_TYPE);
+    }
+    return vmEmitConvert(c, reg, from.pLevel != 0 ? VM_PTR_TYPE : (int) from.pt, to.pt);
+}
+
+// store of evaluateAT, value is already casted
+// Ret: SUCCESS, MALLOC_ERROR
+int vmEmitStore(VmCompiler* c, int addr, int value, Type t) {
+    VmOpcode op;
+
+    if (t.pLevel != 0) op = OP_STORE_PTR;
+    else if (t.pt == PT_FLOAT) op = OP_STORE_FLOAT;
+    else if (t.pt == PT_DOUBLE) op = OP_STORE_DOUBLE;
+    else op = vmWidthOp(OP_STORE_8, sizeOf(t.pt));
+
+    c->storeCount++;
+    return vmEmit(c, op, 0, addr, value);
+}
+
+// evaluateBinary* for evaluated operands, operands may be converted in place
+// Ret: SUCCESS, MALLOC_ERROR
+int vmEmitBinary(VmCompiler* c, BinaryOperatorType op, int dst, int r1, Type t1, int r2, Type t2, int factor) {
+    PrimitiveType castPType;
+    VmOpcode first;
+
+    switch (op) {
+        case OPB_ADD:
+        case OPB_SUB:
+            if (t1.pLevel != 0) {
+                if (t2.pLevel != 0) return vmEmit(c, OP_PTR_SUB_8, dst, r1, r2);
+                if (vmEmitConvert(c, r2, t2.pt, VM_PTR_TYPE) != SUCCESS) return MALLOC_ERROR;
+                return vmEmit(c, vmWidthOp(op == OPB_ADD ? OP_PTR_ADD_8 : OP_PTR_SUB_8, factor), dst, r1, r2);
+            }
+            if (t2.pLevel != 0) {
+                if (vmEmitConvert(c, r1, t1.pt, VM_PTR_TYPE) != SUCCESS) return MALLOC_ERROR;
+                return vmEmit(c, vmWidthOp(OP_PTR_ADD_8, factor), dst, r2, r1);
+            }
+            first = op == OPB_ADD ? OP_ADD_CHAR : OP_SUB_CHAR;
+            break;
+        case OPB_MUL: first = OP_MUL_CHAR; break;
+        case OPB_DIV: first = OP_DIV_CHAR; break;
+        case OPB_MOD: first = OP_MOD_CHAR; break;
+        case OPB_LSH: first = OP_LSH_CHAR; break;
+        case OPB_RSH: first = OP_RSH_CHAR; break;
+        case OPB_EQ: first = OP_EQ_CHAR; break;
+        case OPB_NEQ: first = OP_NEQ_CHAR; break;
+        case OPB_GR: first = OP_GR_CHAR; break;
+        case OPB_LR: first = OP_LR_CHAR; break;
+        case OPB_GRE: first = OP_GRE_CHAR; break;
+        case OPB_LRE: first = OP_LRE_CHAR; break;
+        case OPB_BAND: return vmEmit(c, OP_BAND, dst, r1, r2);
+        case OPB_BOR: return vmEmit(c, OP_BOR, dst, r1, r2);
+        case OPB_XOR: return vmEmit(c, OP_XOR, dst, r1, r2);
+        default: return vmEmit(c, op == OPB_LAND ? OP_LAND : OP_LOR, dst, r1, r2);
+    }
+
+    if (t1.pLevel != 0) return vmEmit(c, first + (VM_PTR_TYPE - PT_CHAR), dst, r1, r2);
+
+    // only the old value of compound assignment differs from type of operator
+    castPType = getCastType(t1.pt, t2.pt);
+    if (vmEmitConvert(c, r1, t1.pt, castPType) != SUCCESS) return MALLOC_ERROR;
+    if (vmEmitConvert(c, r2, t2.pt, castPType) != SUCCESS) return MALLOC_ERROR;
+    return vmEmit(c, first + (castPType - PT_CHAR), dst, r1, r2);
+}
+
+int vmCompileExpression(VmCompiler* c, Expression* expr);
+
+// getLValuePtr
+// Ret: register with address, -1 - cannot be compiled
+int vmCompileLValue(VmCompiler* c, Expression* expr) {
+    int mark = c->regTop, r1, r2;
+
+    switch (expr->type) {
+        case EXPR_VARIABLE:
+            if ((r1 = vmAllocReg(c)) == -1) return -1;
+            if (vmEmit(c, OP_ADDR_VAR, r1, expr->ve.slot & 0xFFFF, expr->ve.slot >> 16) != SUCCESS) return -1;
+            return r1;
+        case EXPR_UNARY:
+            return vmCompileExpression(c, exprAt(c->exprs, expr->ue.expr));
+        default:
+            if ((r1 = vmCompileExpression(c, exprAt(c->exprs, expr->be.expr1))) == -1) return -1;
+            if ((r2 = vmCompileExpression(c, exprAt(c->exprs, expr->be.expr2))) == -1) return -1;
+            if (vmEmitConvert(c, r2, exprAt(c->exprs, expr->be.expr2)->valueType.pt, VM_PTR_TYPE) != SUCCESS) return -1;
+            if (vmEmit(c, vmWidthOp(OP_PTR_ADD_8, expr->be.factor), mark, r1, r2) != SUCCESS) return -1;
+            c->regTop = mark + 1;
+            return mark;
+    }
+}
+
+// Ret: register with value, -1 - cannot be compiled
+int vmCompileUnary(VmCompiler* c, Expression* expr) {
+    int mark = c->regTop, r1;
+    Type t = expr->valueType;
+    VmOpcode first;
+
+    switch (expr->ue.op) {
+        case OPU_INC: first = OP_INC_8; break;
+        case OPU_DEC: first = OP_DEC_8; break;
+        case OPU_P_INC: first = OP_P_INC_8; break;
+        case OPU_P_DEC: first = OP_P_DEC_8; break;
+        case OPU_PLUS:
+            return vmCompileExpression(c, exprAt(c->exprs, expr->ue.expr));
+        case OPU_ADDR_OF:
+            return vmCompileLValue(c, exprAt(c->exprs, expr->ue.expr));
+        case OPU_PTR_DER:
+            if ((r1 = vmCompileLValue(c, expr)) == -1) return -1;
+            if (vmEmit(c, vmWidthOp(OP_LOAD_8, valueWidth(t)), mark, r1, 0) != SUCCESS) return -1;
+            c->regTop = mark + 1;
+            return mark;
+        case OPU_MINUS:
+            if ((r1 = vmCompileExpression(c, exprAt(c->exprs, expr->ue.expr))) == -1) return -1;
+            if (vmEmit(c, OP_NEG_CHAR + (t.pt - PT_CHAR), mark, r1, 0) != SUCCESS) return -1;
+            c->regTop = mark + 1;
+            return mark;
+        case OPU_LNOT:
+            if ((r1 = vmCompileExpression(c, exprAt(c->exprs, expr->ue.expr))) == -1) return -1;
+            if (vmEmit(c, OP_LNOT, mark, r1, 0) != SUCCESS) return -1;
+            c->regTop = mark + 1;
+            return mark;
+        default:
+            if ((r1 = vmCompileExpression(c, exprAt(c->exprs, expr->ue.expr))) == -1) return -1;
+            if (vmEmit(c, vmWidthOp(OP_BNOT_8, sizeOf(t.pt)), mark, r1, 0) != SUCCESS) return -1;
+            c->regTop = mark + 1;
+            return mark;
+    }
+
+    // ++ and --
+    if ((r1 = vmCompileLValue(c, exprAt(c->exprs, expr->ue.expr))) == -1) return -1;
+    c->storeCount++;
+    if (vmEmit(c, vmWidthOp(first, valueWidth(t)), mark, r1, 0) != SUCCESS) return -1;
+    c->regTop = mark + 1;
+    return mark;
+}
+
+// operator is done in type of lvalue when it is the type of operator. Integer +, -, *, &, |, ^
+// give the same low bytes for any wider type, so any integer operand is truncated for them
+// Ret: _OP_END - no compound assignment op, opcode - success
+VmOpcode vmFusedAssignmentOp(BinaryOperatorType op, Type t, Type t2, Type opType) {
+    int isTruncated = t.pt != PT_FLOAT && t.pt != PT_DOUBLE && t2.pt != PT_FLOAT && t2.pt != PT_DOUBLE;
+
+    if (t.pLevel != 0 || t2.pLevel != 0) return _OP_END;
+    if (opType.pLevel != 0 || (opType.pt != t.pt && !isTruncated)) return _OP_END;
+
+    switch (op) {
+        case OPB_ADD: return OP_ADD_AT_CHAR + (t.pt - PT_CHAR);
+        case OPB_SUB: return OP_SUB_AT_CHAR + (t.pt - PT_CHAR);
+        case OPB_MUL: return OP_MUL_AT_CHAR + (t.pt - PT_CHAR);
+        case OPB_BAND: return vmWidthOp(OP_BAND_AT_8, valueWidth(t));
+        case OPB_BOR: return vmWidthOp(OP_BOR_AT_8, valueWidth(t));
+        case OPB_XOR: return vmWidthOp(OP_XOR_AT_8, valueWidth(t));
+        default: break;
+    }
+
+    if (opType.pt != t.pt) return _OP_END;
+    switch (op) {
+        case OPB_DIV: return OP_DIV_AT_CHAR + (t.pt - PT_CHAR);
+        case OPB_MOD: return OP_MOD_AT_CHAR + (t.pt - PT_CHAR);
+        case OPB_LSH: return OP_LSH_AT_CHAR + (t.pt - PT_CHAR);
+        case OPB_RSH: return OP_RSH_AT_CHAR + (t.pt - PT_CHAR);
+        default: return _OP_END;
+    }
+}
+
+// Ret: register with value, -1 - cannot be compiled
+int vmCompileAssignment(VmCompiler* c, AssignmentExpression* expr) {
+    static const BinaryOperatorType compoundOps[] = {
+        OPB_ADD, OPB_SUB, OPB_MUL, OPB_DIV, OPB_MOD, OPB_LSH, OPB_RSH, OPB_BAND, OPB_BOR, OPB_XOR,
+    };
+    int rTo, rWhat, rOld, factor;
+    Type t = exprAt(c->exprs, expr->expr1)->valueType, opType;
+
+    if (expr->op == OPA_AT) {
+        if ((rWhat = vmCompileExpression(c, exprAt(c->exprs, expr->expr2))) == -1) return -1;
+        if ((rTo = vmCompileLValue(c, exprAt(c->exprs, expr->expr1))) == -1) return -1;
+    }
+    else {
+        BinaryOperatorType op = compoundOps[expr->op - OPA_ADD_AT];
+
+        Type t2 = exprAt(c->exprs, expr->expr2)->valueType;
+        VmOpcode fused;
+
+        // lvalue is evaluated once, then `*lvalue = *lvalue OP expr2` as in evaluateAssignment
+        if ((rTo = vmCompileLValue(c, exprAt(c->exprs, expr->expr1))) == -1) return -1;
+        if ((rWhat = vmCompileExpression(c, exprAt(c->exprs, expr->expr2))) == -1) return -1;
+        resolveBinaryType(op, t, t2, &opType, &factor);
+
+        fused = vmFusedAssignmentOp(op, t, t2, opType);
+        if (fused != _OP_END) {
+            if (vmEmitConvert(c, rWhat, t2.pt, t.pt) != SUCCESS) return -1;
+            c->storeCount++;
+            if (vmEmit(c, fused, rWhat, rTo, rWhat) != SUCCESS) return -1;
+            return rWhat;
+        }
+
+        if ((rOld = vmAllocReg(c)) == -1) return -1;
+        if (vmEmit(c, vmWidthOp(OP_LOAD_8, valueWidth(t)), rOld, rTo, 0) != SUCCESS) return -1;
+        if (vmEmitBinary(c, op, rOld, rOld, t, rWhat, t2, factor) != SUCCESS) return -1;
+        if (vmEmitCast(c, rOld, opType, t) != SUCCESS) return -1;
+        rWhat = rOld;
+    }
+
+    if (vmEmitStore(c, rTo, rWhat, t) != SUCCESS) return -1;
+    return rWhat;
+}
+
+// expression is resolved by resolveStatement
+// Ret: register with value, -1 - cannot be compiled
+int vmCompileExpression(VmCompiler* c, Expression* expr) {
+    int mark = c->regTop, r1, r2;
+
+    switch (expr->type) {
+        case EXPR_VALUE:
+            if ((r1 = vmAllocReg(c)) == -1) return -1;
+            if (vmEmitConst(c, r1, expr->vle.ull) != SUCCESS) return -1;
+            return r1;
+        case EXPR_VARIABLE:
+            if ((r1 = vmAllocReg(c)) == -1) return -1;
+            if (vmEmit(c, vmWidthOp(OP_LOAD_VAR_8, valueWidth(expr->valueType)), r1, expr->ve.slot & 0xFFFF, expr->ve.slot >> 16) != SUCCESS) return -1;
+            return r1;
+        case EXPR_CAST:
+            if ((r1 = vmCompileExpression(c, exprAt(c->exprs, expr->ce.expr))) == -1) return -1;
+            if (vmEmitCast(c, r1, exprAt(c->exprs, expr->ce.expr)->valueType, expr->ce.type) != SUCCESS) return -1;
+            return r1;
+        case EXPR_UNARY:
+            return vmCompileUnary(c, expr);
+        case EXPR_ASSIGNMENT:
+            return vmCompileAssignment(c, &expr->ae);
+        case EXPR_BINARY:
+            if (expr->be.op == OPB_SQ_BRACKETS) {
+                if (vmCompileLValue(c, expr) == -1) return -1;
+                if (vmEmit(c, vmWidthOp(OP_LOAD_8, valueWidth(expr->valueType)), mark, mark, 0) != SUCCESS) return -1;
+            }
+            else {
+                if ((r2 = vmCompileExpression(c, exprAt(c->exprs, expr->be.expr2))) == -1) return -1;
+                if ((r1 = vmCompileExpression(c, exprAt(c->exprs, expr->be.expr1))) == -1) return -1;
+                if (vmEmitBinary(c, expr->be.op, mark, r1, exprAt(c->exprs, expr->be.expr1)->valueType,
+                                 r2, exprAt(c->exprs, expr->be.expr2)->valueType, expr->be.factor) != SUCCESS) return -1;
+            }
+            c->regTop = mark + 1;
+            return mark;
+        case EXPR_COMMA:
+            for (uint i = 0; ; i++) {
+                if ((r1 = vmCompileExpression(c, exprAt(c->exprs, exprItem(c->exprs, expr->cme.exprs, i)))) == -1) return -1;
+                if (i + 1 == expr->cme.exprs.count) return r1;
+                c->regTop = mark;
+            }
+        default:
+            return -1;
+    }
+}
+
+// root is replaced with compiled expression when its type is resolved
+// Ret: SUCCESS, MALLOC_ERROR
+int vmCompileRoot(Program* prog, VmCompiler* c, ExprId* root) {
+    Expression* expr = exprAt(c->exprs, *root),* compiled;
+    VmCode* code;
+    int r;
+
+    if (isVoidType(expr->valueType)) return SUCCESS;
+
+    c->count = 0;
+    c->regTop = 0;
+    c->storeCount = 0;
+
+    r = vmCompileExpression(c, expr);
+    if (c->mallocFailed) return MALLOC_ERROR;
+    if (r == -1 || c->storeCount > VM_MAX_UNDO) return SUCCESS;
+    if (vmEmit(c, OP_END, 0, 0, 0) != SUCCESS) return MALLOC_ERROR;
+
+    code = (VmCode*) arenaAlloc(&prog->arena, sizeof(VmCode));
+    compiled = allocExpression(&prog->exprs, EXPR_COMPILED);
+    if (code == NULL || compiled == NULL) return MALLOC_ERROR;
+
+    code->instrs = (VmInstr*) arenaAlloc(&prog->arena, c->count * sizeof(VmInstr));
+    if (code->instrs == NULL) return MALLOC_ERROR;
+    memcpy(code->instrs, c->instrs, c->count * sizeof(VmInstr));
+    code->type = expr->valueType;
+    code->result = r;
+
+    compiled->valueType = code->type;
+    compiled->cpe.code = code;
+    compiled->cpe.source = *root;
+    *root = exprId(&prog->exprs, compiled);
+    return SUCCESS;
+}
+
+// Ret: SUCCESS, MALLOC_ERROR
+int vmCompileStatement(Program* prog, VmCompiler* c, Statement* st) {
+    int status = SUCCESS;
+
+    switch (st->type) {
+        case ST_EXPRESSION:
+            return vmCompileRoot(prog, c, &st->es.expr);
+        case ST_PRINT:
+            return vmCompileRoot(prog, c, &st->ps.expr);
+        case ST_VARIABLE_DECLARATION:
+            for (int i = 0; i < st->vs.vAmount && status == SUCCESS; i++) {
+                VarDeclField* f = &st->vs.variables[i];
+
+                if (f->isArray) {
+                    for (uint j = 0; j < f->inits.count && f->values == NULL && status == SUCCESS; j++) {
+                        status = vmCompileRoot(prog, c, &exprItem(&prog->exprs, f->inits, j));
+                    }
+                }
+                else if (f->expr != 0) {
+                    status = vmCompileRoot(prog, c, &f->expr);
+                }
+            }
+            return status;
+        default:
+            return SUCCESS;
+    }
+}
+
+// state of resolving and compiling which is kept from statement to statement
+typedef struct {
+    TypeResolver r;
+    VmCompiler c;
+    Context foldCtx;
+    int slotCapacity;
+    int skipsCompiling; // program is saved to image, its code is compiled when it is loaded
+} Preparer;
+
+// Ret: SUCCESS, MALLOC_ERROR
+int initPreparer(Preparer* p, Program* prog) {
+    memset(p, 0, sizeof(*p));
+    p->r.exprs = &prog->exprs;
+    p->c.exprs = &prog->exprs;
+    p->r.foldCtx = &p->foldCtx;
+    return ctxInit(&p->foldCtx, prog, 0, 0);
+}
+
+// types of variables of the previous program are forgotten
+void resetPreparer(Preparer* p) {
+    if (p->r.slotTypes != NULL) memset(p->r.slotTypes, 0, p->slotCapacity * sizeof(Type));
+}
+
+void freePreparer(Preparer* p) {
+    free(p->r.slotTypes);
+    free(p->c.instrs);
+    freeContext(&p->foldCtx);
+}
+
+// types of statement are resolved and constants are folded and packed, then resolved roots are compiled.
+// Both passes are done while nodes of the statement are in cache
+// Ret: SUCCESS, MALLOC_ERROR
+int prepareStatement(Preparer* p, Program* prog, Statement* st) {
+    // symbols are added by parsing of statements
+    if (prog->symbols.count > p->slotCapacity) {
+        int newCapacity = prog->symbols.count * ARRAY_GROW_FACTOR + 1;
+        Type* newTypes = (Type*) realloc(p->r.slotTypes, newCapacity * sizeof(Type));
+
+        if (newTypes == NULL) return MALLOC_ERROR;
+        memset(newTypes + p->slotCapacity, 0, (newCapacity - p->slotCapacity) * sizeof(Type));
+        p->r.slotTypes = newTypes;
+        p->slotCapacity = newCapacity;
+    }
+
+    if (resolveStatement(&p->r, st) != SUCCESS) return MALLOC_ERROR;
+    if (packArrayInits(prog, st) != SUCCESS) return MALLOC_ERROR;
+    if (p->skipsCompiling) return SUCCESS;
+    return vmCompileStatement(prog, &p->c, st);
+}
+
+// statements are prepared in statements order
+// Ret: SUCCESS, MALLOC_ERROR
+int prepareProgram(Program* prog, int isCompiled) {
+    Preparer p;
+    int status = initPreparer(&p, prog);
+
+    p.skipsCompiling = !isCompiled;
+    for (int i = 0; i < prog->statementCount && status == SUCCESS; i++) {
+        status = prepareStatement(&p, prog, &prog->statements[i]);
+    }
+
+    freePreparer(&p);
+    return status;
+}
+
+// resolved roots of program loaded from image are compiled
+// Ret: SUCCESS, MALLOC_ERROR
+int compileProgram(Program* prog) {
+    VmCompiler c;
+    int status = SUCCESS;
+
+    memset(&c, 0, sizeof(c));
+    c.exprs = &prog->exprs;
+    for (int i = 0; i < prog->statementCount && status == SUCCESS; i++) {
+        status = vmCompileStatement(prog, &c, &prog->statements[i]);
+    }
+
+    free(c.instrs);
+    return status;
+}
+
+ValueExpression evaluateExpression(Context* ctx, int* changesAnyValue, Expression* expr) {
+    switch (expr->type)
+    {
+        case EXPR_ASSIGNMENT:
+            return evaluateAssignment(ctx, changesAnyValue, &expr->ae);
+        case EXPR_BINARY:
+            return evaluateBinary(ctx, changesAnyValue, &expr->be);
+        case EXPR_UNARY:
+            return evaluateUnary(ctx, changesAnyValue, &expr->ue);
+        case EXPR_CAST: {
+            ValueExpression ve = evaluateExpression(ctx, changesAnyValue, exprAt(ctx->exprs, expr->ce.expr));
+            ve = castTo(expr->ce.type, &ve);
+            // operators report errors of their operands
+            if (expr->ce.isImplicit) return ve;
+            if (probablyError(&ve)) {
+                evalError("Cannot cast types");
+            }
+            return ve;
+        }
+        case EXPR_VARIABLE: {
+            CtxVariable* var = ctxGetVariable(ctx, expr->ve.slot);
+            ValueExpression v;
+
+            if (var == NULL) {
+                initValueExpression(&v);
+
+                evalError("Cannot find variable `%s`", ctx->symbols->names[expr->ve.slot]);
+                return v;
+            }
+            *changesAnyValue = 0;
+            v = var->v;
+            v.ull = 0;
+            memcpy(&v.ull, var->data, var->width);
+            return v;
+        }
+        case EXPR_VALUE:
+            *changesAnyValue = 0;
+            return expr->vle;
+        case EXPR_COMMA:
+            *changesAnyValue = 0;
+
+            for (uint i = 0; ; i++) {
+                Expression* item = exprAt(ctx->exprs, exprItem(ctx->exprs, expr->cme.exprs, i));
+                int changes = 0;
+
+                if (i + 1 != expr->cme.exprs.count) {
+                    evaluateExpression(ctx, &changes, item);
+                    if (changes) *changesAnyValue = 1;
+                }
+                else {
+                    ValueExpression ve = evaluateExpression(ctx, &changes, item);
+                    if (changes) *changesAnyValue = 1;
+
+                    return ve;
+                }
+            }
+            error("Error cannot be there");
+        case EXPR_COMPILED: {
+            ValueExpression ve;
+            int changes = 0;
+
+            if (vmRun(ctx, expr->cpe.code, &changes, &ve) != SUCCESS) {
+                return evaluateExpression(ctx, changesAnyValue, exprAt(ctx->exprs, expr->cpe.source));
+            }
+            if (changes) *changesAnyValue = 1;
+            return ve;
+        }
+        default: {
+            ValueExpression v;
+            initValueExpression(&v);
+            *changesAnyValue = 0;
+            error("Cannot evaluate expression type %d", expr->type);
+            return v;
+        }   
+    }
+}
+
+// Ret: ERROR, MALLOC_ERROR, SUCCESS
+int interpretStatement(int* fChanges, Context* ctx, Statement* statement) {
+    ctx->hasEvaluationError = 0;
+
+    switch (statement->type)
+    {
+        case ST_VARIABLE_DECLARATION:
+            for (int i = 0; i < statement->vs.vAmount; i++) {
+                VarDeclField* f = &statement->vs.variables[i];
+                int j, regStatus, factor;
+                CtxVariable* registeredVarPtr;
+                Type declType;
+                ValueExpression ve;
+
+                initValueExpression(&ve);
+                declType.pLevel = f->pLevel;
+                declType.pt = statement->vs.vType;
+
+                if (declType.pt == PT_VOID && declType.pLevel == 0) {
+                    evalError("Cannot create variable with void type");
+                    return ERROR;
+                }
+
+                if (f->isArray) {
+                    void* ptr; 
+                    int arrSize;
+
+                    ve.type = declType;
+                    ve.type.pLevel++;
+
+                    factor = getPointerOperationFactor(&ve.type);
+                    if (factor == 0) {
+                        evalError("Cannot get size of array type");
+                        return ERROR;
+                    }
+
+                    arrSize = f->arraySize;
+                    if (arrSize == 0) arrSize = f->inits.count;
+
+                    // memory of sandboxed context is zeroed
+                    if (ctx->mem != NULL) ptr = ctxAllocData(ctx, factor * arrSize, factor);
+                    else {
+                        ptr = calloc(arrSize ? arrSize : 1, factor);
+                        if (ptr != NULL && ctxAddArray(ctx, ptr) != SUCCESS) ptr = NULL;
+                    }
+                    if (ptr == NULL) {
+                        error("Cannot allocate array for variable");
+                        return MALLOC_ERROR;
+                    }
+
+                    if (ctxAddMemoryRegion(ctx, ptr, arrSize * factor) != SUCCESS) {
+                        error("Memory allocation error");
+                        return MALLOC_ERROR;
+                    }
+
+                    if (f->values != NULL) {
+                        if ((int) f->inits.count > arrSize) {
+                            evalError("Too many expressions in array");
+                            return ERROR;
+                        }
+                        memcpy(ptr, f->values, (size_t) f->inits.count * factor);
+                    }
+
+                    for (j = 0; j < (int) f->inits.count && f->values == NULL; j++) {
+                        ValueExpression evaluated;
+                        if (j >= arrSize) {
+                            evalError("Too many expressions in array");
+                            return ERROR;
+                        }
+
+                        evaluated = evaluateExpression(ctx, fChanges, exprAt(ctx->exprs, exprItem(ctx->exprs, f->inits, j)));
+
+                        if (evaluated.type.pt != declType.pt || evaluated.type.pLevel != declType.pLevel) {
+                            evaluated = castTo(declType, &evaluated);
+                            if (probablyError(&evaluated)) {
+                                evalError("Cannot cast evaluated value to array type");
                                 return ERROR;
                             }
                         }
 
-                        if (evaluated.type.pLevel != 0) {
-                            *((size*)ptr + j) = evaluated.st;
-                            continue;
-                        }
+                        if (evaluated.type.pLevel != 0) {
+                            *((size*)ptr + j) = evaluated.st;
+                            continue;
+                        }
+
+                        #define CASE(T, t, F)   case PT_##T:                        \
+                                                case PT_U##T:                       \
+                                                    *((t*)ptr + j) = evaluated. F;  \
+                                                    break;
+
+                        switch (evaluated.type.pt)
+                        {
+                            case PT_VOID:
+                                evalError("Cannot assign void value to array element");
+                                return ERROR;
+                            CASE(CHAR, char, c)
+                            CASE(SHORT, short, s)
+                            CASE(INT, int, i)
+                            CASE(LONG, long, l)
+                            CASE(LONGLONG, longlong, ll)
+                            case PT_FLOAT:
+                                *((float*)ptr + j) = evaluated.f;
+                                break;
+                            case PT_DOUBLE:
+                                *((double*)ptr + j) = evaluated.d;
+                                break;
+                            default:
+                                error("Bad primitive type %d", evaluated.type.pt);
+                                return ERROR;
+                        }
+
+                        #undef CASE
+                    }
+                    
+                    ve.st = ctxPointer(ctx, ptr);
+                }
+                else {
+                    ve.type = declType;
+
+                    if (ctx->params != NULL && ctx->params[f->slot].type.pt != PT_VOID) {
+                        ve = ctx->params[f->slot];
+                    }
+                    else if (f->expr != 0) {
+                        ve = evaluateExpression(ctx, fChanges, exprAt(ctx->exprs, f->expr));
+                    }
+                    if (declType.pt != ve.type.pt || declType.pLevel != ve.type.pLevel) {
+                        ve = castTo(declType, &ve);
+                        if (probablyError(&ve)) {
+                            evalError("Cannot assign value to variable");
+                            return ERROR;
+                        }
+                    }
+                }
+                regStatus = ctxRegisterVariable(ctx, f->slot, ve, &registeredVarPtr);
+                if (regStatus == ERROR) {
+                    evalError("Cannot register variable `%s`", ctx->symbols->names[f->slot]);
+                    return ERROR;
+                }
+                if (regStatus == MALLOC_ERROR) {
+                    error("Cannot allocate variable");
+                    return MALLOC_ERROR;
+                }
+            }
+            *fChanges = 1;
+            break;
+        case ST_EXPRESSION:
+            evaluateExpression(ctx, fChanges, exprAt(ctx->exprs, statement->es.expr));
+            break;
+        case ST_PRINT: {
+            ValueExpression ve = evaluateExpression(ctx, fChanges, exprAt(ctx->exprs, statement->ps.expr));
+            printValueExpression(&ve);
+            break;
+        }
+        default:
+            error("Bad statement type %d", statement->type);
+            return ERROR;
+    }
+
+    if (ctx->hasEvaluationError) return ERROR;
+    return SUCCESS;
+}
+
+#undef evalError
+
+// tokens of operator `c` and of its longer forms `c=`, `cc` and `cc=`, TK_END - there is no such form
+typedef struct {
+    TokenType single, withEq, doubled, doubledEq;
+} OperatorLexeme;
+
+const OperatorLexeme operatorLexemes[256] = {
+    ['+'] = {TK_PLUS, TK_PLUS_EQ, TK_PLUS_PLUS, TK_END},
+    ['-'] = {TK_MINUS, TK_MINUS_EQ, TK_MINUS_MINUS, TK_END},
+    ['*'] = {TK_STAR, TK_STAR_EQ, TK_END, TK_END},
+    ['/'] = {TK_SLASH, TK_SLASH_EQ, TK_END, TK_END},
+    ['%'] = {TK_PERCENT, TK_PERCENT_EQ, TK_END, TK_END},
+    ['&'] = {TK_AMPERSAND, TK_AMPERSAND_EQ, TK_AMPERSAND_AMPERSAND, TK_END},
+    ['|'] = {TK_PIPE, TK_PIPE_EQ, TK_PIPE_PIPE, TK_END},
+    ['^'] = {TK_CARET, TK_CARET_EQ, TK_END, TK_END},
+    ['='] = {TK_EQ, TK_EQ_EQ, TK_END, TK_END},
+    ['!'] = {TK_EX_POINT, TK_NEQ, TK_END, TK_END},
+    ['<'] = {TK_LR, TK_LRE, TK_LR_LR, TK_LR_LR_EQ},
+    ['>'] = {TK_GR, TK_GRE, TK_GR_GR, TK_GR_GR_EQ},
+    ['~'] = {TK_TILDE},
+    [','] = {TK_COMMA},
+    ['('] = {TK_LPAREN}, [')'] = {TK_RPAREN},
+    ['['] = {TK_LPAREN_SQ}, [']'] = {TK_RPAREN_SQ},
+    ['{'] = {TK_LBR}, ['}'] = {TK_RBR},
+};
+
+typedef struct {
+    const char* name;
+    uint len;
+    TokenType type;
+} Keyword;
+
+// perfect hash of the keyword set, see keywordHash
+const Keyword keywords[KEYWORD_HASH_SIZE] = {
+    [0] = {"int", 3, TK_INT},
+    [1] = {"unsigned", 8, TK_UNSIGNED},
+    [9] = {"print", 5, TK_PRINT},
+    [12] = {"short", 5, TK_SHORT},
+    [15] = {"double", 6, TK_DOUBLE},
+    [23] = {"long", 4, TK_LONG},
+    [25] = {"char", 4, TK_CHAR},
+    [29] = {"signed", 6, TK_SIGNED},
+    [30] = {"void", 4, TK_VOID},
+    [31] = {"float", 5, TK_FLOAT},
+};
+
+#define keywordHash(s, len) (((len) + (uchar) (s)[0] + (uchar) (s)[(len) - 1]) & (KEYWORD_HASH_SIZE - 1))
+
+TokenType identifierType(const char* s, uint len) {
+    const Keyword* kw = &keywords[keywordHash(s, len)];
+    if (kw->len == len && memcmp(kw->name, s, len) == 0) return kw->type;
+    return TK_ID;
+}
+
+// powers which are exact in double and float, so one multiplication or division is correctly rounded
+const double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+const float exactPowersOf10F[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+#define MAX_EXACT_MANTISSA (1ull << 53)
+#define MAX_EXACT_MANTISSA_F (1ull << 24)
+#define MAX_EXACT_EXP10 22
+#define MAX_EXACT_EXP10_F 10
+
+// m * 10^exp10 is exact if both are exact; other values are converted from the source by libc
+double decimalToDouble(ulonglong m, int exp10, int isExact, const char* source) {
+    if (isExact && m <= MAX_EXACT_MANTISSA && abs(exp10) <= MAX_EXACT_EXP10) {
+        return exp10 < 0 ? (double) m / exactPowersOf10[-exp10] : (double) m * exactPowersOf10[exp10];
+    }
+    return strtod(source, NULL);
+}
+
+float decimalToFloat(ulonglong m, int exp10, int isExact, const char* source) {
+    if (isExact && m <= MAX_EXACT_MANTISSA_F && abs(exp10) <= MAX_EXACT_EXP10_F) {
+        return exp10 < 0 ? (float) m / exactPowersOf10F[-exp10] : (float) m * exactPowersOf10F[exp10];
+    }
+    return strtof(source, NULL);
+}
+
+// type of integer constant by value and suffix like in C, but constant without `l` and `u` is
+// long long. Decimal one which is too big is saturated, hex one becomes unsigned
+PrimitiveType integerConstantType(ulonglong* v, int isHex, int isUnsigned, int longs) {
+    if (isUnsigned) {
+        if (longs == 2) return PT_ULONGLONG;
+        return longs == 0 && *v <= UINT_MAX ? PT_UINT : PT_ULONG;
+    }
+    if (*v > LLONG_MAX && !isHex) *v = LLONG_MAX;
+    if (longs == 1) return *v <= LONG_MAX ? PT_LONG : PT_ULONG;
+    return *v <= LLONG_MAX ? PT_LONGLONG : PT_ULONGLONG;
+}
+
+// decimal, hex or floating constant with suffix is parsed from the source, without copying
+// Ret: end of constant
+char* parseNumber(Token* to, char* s) {
+    char* start = s;
+    ulonglong m = 0;
+    int exp10 = 0, isOverflow = 0, isFloat = 0;
+
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        int isUnsigned = 0, longs = 0;
+
+        for (s += 2; isCharClass(*s, CC_XDIGIT); s++) {
+            uint d = isCharClass(*s, CC_DIGIT) ? *s - '0' : (*s | 0x20) - 'a' + 10;
+
+            if (m >> 60 != 0) isOverflow = 1;
+            m = m << 4 | d;
+        }
+        if (isOverflow) m = ULLONG_MAX;
+
+        for (;;) {
+            if ((*s == 'u' || *s == 'U') && !isUnsigned) s++, isUnsigned = 1;
+            else if ((*s == 'l' || *s == 'L') && longs == 0) longs = s[1] == s[0] ? 2 : 1, s += longs;
+            else break;
+        }
+
+        to->type = TK_INT_CONSTANT;
+        to->constType = integerConstantType(&m, 1, isUnsigned, longs);
+        to->iVal = (longlong) m;
+        return s;
+    }
+
+    // digits which don't fit are counted by exponent, so the constant isn't exact
+    for (; isCharClass(*s, CC_DIGIT); s++) {
+        uint d = *s - '0';
+
+        if (m <= (ULLONG_MAX - d) / 10) m = m * 10 + d;
+        else isOverflow = 1, exp10++;
+    }
+    if (*s == '.') {
+        isFloat = 1;
+        for (s++; isCharClass(*s, CC_DIGIT); s++) {
+            uint d = *s - '0';
+
+            if (m <= (ULLONG_MAX - d) / 10) m = m * 10 + d, exp10--;
+            else isOverflow = 1;
+        }
+    }
+    if ((*s == 'e' || *s == 'E') &&
+        (isCharClass(s[1], CC_DIGIT) || ((s[1] == '+' || s[1] == '-') && isCharClass(s[2], CC_DIGIT)))) {
+        int sign = 1, e = 0;
+
+        isFloat = 1;
+        s++;
+        if (*s == '+' || *s == '-') sign = *s++ == '-' ? -1 : 1;
+        for (; isCharClass(*s, CC_DIGIT); s++) {
+            if (e < 100000) e = e * 10 + *s - '0';
+        }
+        exp10 += sign * e;
+    }
+
+    if (isFloat) {
+        to->type = TK_FLOAT_CONSTANT;
+        if (*s == 'f' || *s == 'F') {
+            s++;
+            to->constType = PT_FLOAT;
+            to->fVal = decimalToFloat(m, exp10, !isOverflow, start);
+        }
+        else {
+            if (*s == 'l' || *s == 'L') s++;
+            to->constType = PT_DOUBLE;
+            to->fVal = decimalToDouble(m, exp10, !isOverflow, start);
+        }
+    }
+    else {
+        int isUnsigned = 0, longs = 0;
+
+        for (;;) {
+            if ((*s == 'u' || *s == 'U') && !isUnsigned) s++, isUnsigned = 1;
+            else if ((*s == 'l' || *s == 'L') && longs == 0) longs = s[1] == s[0] ? 2 : 1, s += longs;
+            else break;
+        }
+        if (isOverflow) m = ULLONG_MAX;
+
+        to->type = TK_INT_CONSTANT;
+        to->constType = integerConstantType(&m, 0, isUnsigned, longs);
+        to->iVal = (longlong) m;
+    }
+    return s;
+}
+
+// Ret: value of number constant of type given by its suffix
+ValueExpression tokenValue(const Token* tk) {
+    ValueExpression v;
+
+    v.type.pLevel = 0;
+    if (tk->type == TK_INT_CONSTANT) {
+        v.type.pt = PT_LONGLONG;
+        v.ll = tk->iVal;
+    }
+    else {
+        v.type.pt = PT_DOUBLE;
+        v.d = tk->fVal;
+    }
+    if (tk->constType != v.type.pt) v = castTo((Type) {tk->constType, 0}, &v);
+    return v;
+}
+
+// Ret: NULL - no token detected, next s - success
+char* parseToken(Token* to, char* s) {
+    const OperatorLexeme* op;
+    s = strskp(s);
+    to->text = s;
+
+    if (*s == 0 || *s == ';') to->type = TK_END;
+    else if (isCharClass(*s, CC_ID)) {
+        s++;
+        while (isCharClass(*s, CC_ID | CC_DIGIT)) s++;
+        to->type = identifierType(to->text, s - to->text);
+    }
+    else if (isCharClass(*s, CC_DIGIT) || *s == '.') {
+        s = parseNumber(to, s);
+    }
+    else if (*s == SINGLE_QUOTE || *s == '"') {
+        // TODO: parse char and string
+        error("Not implemented");
+        return NULL;
+    }
+    else {
+        op = &operatorLexemes[(uchar) *s];
+        if (op->single == TK_END) return NULL;
+
+        s++;
+        if (*s == '=' && op->withEq != TK_END) s++, to->type = op->withEq;
+        else if (*s == s[-1] && op->doubled != TK_END) {
+            s++;
+            if (*s == '=' && op->doubledEq != TK_END) s++, to->type = op->doubledEq;
+            else to->type = op->doubled;
+        }
+        else to->type = op->single;
+    }
+
+    to->len = s - to->text;
+    return s;
+}
+
+// statement is lexed in one pass, parser takes tokens from the buffer
+// Ret: SUCCESS, MALLOC_ERROR
+int lexStatement(Program* prog, char* s) {
+    Token* tk;
+    int count = 0;
+
+    do {
+        char* next;
+
+        if (count == prog->tokenCapacity) {
+            int newCapacity = prog->tokenCapacity ? prog->tokenCapacity * ARRAY_GROW_FACTOR : TOKENS_START_CAP;
+            Token* newTokens = (Token*) realloc(prog->tokens, newCapacity * sizeof(Token));
+
+            if (newTokens == NULL) return MALLOC_ERROR;
+            prog->tokens = newTokens;
+            prog->tokenCapacity = newCapacity;
+        }
+
+        tk = &prog->tokens[count++];
+        next = parseToken(tk, s);
+        if (next == NULL) {
+            tk->type = TK_UNKNOWN;
+            tk->len = 1;
+            next = (char*) tk->text + 1;
+        }
+        s = next;
+    } while (tk->type != TK_END);
+
+    return SUCCESS;
+}
+
+// tk is current token, st is the next one in the token buffer, TK_END is never passed
+#define next() (*tk = *st, st += st->type != TK_END)
+#define match(t) (tk->type == t ? next(), 1 : 0)
+#define is(t) (tk->type == t)
+// the first error of statement gives its position
+#define parserError(args...) {                                      \
+    if (prog->errorToken == NULL) prog->errorToken = tk->text;      \
+    outPrintf("Parser error: "); outPrintf(args); outPrintf("\n");  \
+}
+#define errExp(T) parserError("Expected " #T)
+
+int parseExpression(Program* prog, Token* tk, ExprId* toE, const Token* st, const Token** toS);
+
+int isPrefixUnaryToken(Token* tk) {
+    return is(TK_PLUS_PLUS) || is(TK_MINUS_MINUS) || is(TK_PLUS) || is(TK_MINUS) ||
+            is(TK_EX_POINT) || is(TK_TILDE) || is(TK_STAR) || is(TK_AMPERSAND);
+}
+
+int isPostfixUnaryToken(Token* tk) {
+    return is(TK_PLUS_PLUS) || is(TK_MINUS_MINUS);
+}
+
+int isTypeBeginning(Token* tk) {
+    return is(TK_UNSIGNED) || is(TK_SIGNED) || is(TK_VOID) || is(TK_CHAR) || 
+        is(TK_SHORT) || is(TK_INT) || is(TK_LONG) || is(TK_FLOAT) || is(TK_DOUBLE);
+}
+
+// Ret: NULL is error, next s if success
+const Token* parseDeclarationType(Token* tk, PrimitiveType* to, const Token* st) {
+    struct {
+        uint isChar : 1;
+        uint isShort : 1;
+        uint isFloat : 1;
+        uint isDouble : 1;
+        uint isVoid : 1;
+    } t;
+
+    static_assert(sizeof(t) == sizeof(int), "Need change type");
+
+    int* ti = (int*) &t;
+    int cntLong = 0;
+    int isUnsigned = 0;
+    int isSigned = 0;
+    int isInt = 0;
+
+    *ti = 0;
+
+    for (;;) {
+        if (match(TK_VOID)) { if (*ti) return NULL; t.isVoid = 1; }
+        else if (match(TK_CHAR)) { if (*ti) return NULL; t.isChar = 1; }
+        else if (match(TK_SHORT)) { if (*ti) return NULL; t.isShort = 1; }
+        else if (match(TK_INT)) { if (t.isChar || t.isFloat || t.isDouble || isInt) return NULL; isInt = 1; }
+
+        else if (match(TK_FLOAT)) { if (*ti || isInt) return NULL; t.isFloat = 1; }
+        else if (match(TK_DOUBLE)) { if (*ti || isInt) return NULL; t.isDouble = 1; }
+
+        else if (match(TK_UNSIGNED)) { if (isUnsigned || isSigned) return NULL; isUnsigned = 1; }
+        else if (match(TK_SIGNED)) { if (isSigned || isUnsigned) return NULL; isSigned = 1; }
+
+        else if (match(TK_LONG)) cntLong++;
+        else break;
+    }
+
+    if (t.isVoid) {
+        if (cntLong != 0) return NULL;
+        if (isUnsigned != 0) return NULL;
+        if (isSigned != 0) return NULL;
+        if (isInt != 0) return NULL;
+
+        *to = PT_VOID;
+        return st;
+    }
+    if (t.isChar) {
+        if (cntLong != 0) return NULL;
+        if (isUnsigned) {
+            *to = PT_UCHAR;
+            return st;
+        }
+        *to = PT_CHAR;
+        return st;
+    }
+    if (t.isShort) {
+        if (cntLong != 0) return NULL;
+        if (isUnsigned) {
+            *to = PT_USHORT;
+            return st;
+        }
+        *to = PT_SHORT;
+        return st;
+    }
+    if (t.isFloat) {
+        if (isUnsigned != 0) return NULL;
+        if (isSigned != 0) return NULL;
+
+        if (cntLong == 0) {
+            *to = PT_FLOAT;
+            return st;
+        }
+        if (cntLong >= 1) {
+            *to = PT_DOUBLE;
+            return st;
+        }
+
+        error("Error cannot be there");
+        return NULL;
+    }
+    if (t.isDouble) {
+        if (isUnsigned != 0) return NULL;
+        if (isSigned != 0) return NULL;
+
+        *to = PT_DOUBLE;
+        return st;
+    }
+
+    if (cntLong == 1) {
+        if (isUnsigned) {
+            *to = PT_ULONG;
+            return st;
+        }
+        *to = PT_LONG;
+        return st;
+    }
+    if (cntLong >= 2) {
+        if (isUnsigned) {
+            *to = PT_ULONGLONG;
+            return st;
+        }
+        *to = PT_LONGLONG;
+        return st;
+    }
+
+    *to = PT_INT;
+    return st;
+}
+
+const Token* parseType(Token* tk, Type* to, const Token* st) {
+    Type t;
+    
+    st = parseDeclarationType(tk, &t.pt, st);
+    if (st == NULL) return NULL;
+
+    t.pLevel = 0;
+
+    while (match(TK_STAR)) t.pLevel++;
+    *to = t;
+
+    return st;
+}
+
+// parse: ( ^ expr...)
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseBracketsExpression(Program* prog, Token* tk, ExprId* toE, const Token* st, const Token** toS) {
+    ExprId expr;
+    int err = parseExpression(prog, tk, &expr, st, &st);
+    if (err != SUCCESS) return err;
+
+    if (!match(TK_RPAREN)) {
+        errExp(TK_RPAREN);
+        return ERROR;
+    }
+
+    *toE = expr;
+    *toS = st;
+    return SUCCESS;
+}
+
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+// parse: ValueExpression & VariableExpression
+int parseSimpleExpression(Program* prog, Token* tk, ExprId* toE, const Token* st, const Token** toS) {
+    Expression* expr;
+    int err;
+
+    if (is(TK_ID)) {
+        expr = allocExpression(&prog->exprs, EXPR_VARIABLE);
+        if (expr == NULL) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+        expr->ve.slot = symbolIntern(&prog->symbols, tk->text, tk->len);
+        if (expr->ve.slot < 0) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+        next();
+    }
+    else if (is(TK_INT_CONSTANT) || is(TK_FLOAT_CONSTANT)) {
+        expr = allocExpression(&prog->exprs, EXPR_VALUE);
+        if (expr == NULL) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+        expr->vle = tokenValue(tk);
+        next();
+    }
+    else {
+        return ERROR;
+    }
+    
+
+    *toE = exprId(&prog->exprs, expr);
+    *toS = st;
+    return SUCCESS;
+}
 
-                        #define CASE(T, t, F)   case PT_##T:                        \
-                                                case PT_U##T:                       \
-                                                    *((t*)ptr + j) = evaluated. F;  \
-                                                    break;
+// postfix operators are applied to *expr, the first one is the outer one
+// Ret: SUCCESS, MALLOC_ERROR
+int parsePostfixOperators(Program* prog, Token* tk, ExprId* expr, const Token* st, const Token** toS) {
+    Expression* newExpr;
+    UnaryOperatorType op;
+    int err;
 
-                        switch (evaluated.type.pt)
-                        {
-                            case PT_VOID:
-                                evalError("Cannot assign void value to array element");
-                                return ERROR;
-                            CASE(CHAR, char, c)
-                            CASE(SHORT, short, s)
-                            CASE(INT, int, i)
-                            CASE(LONG, long, l)
-                            CASE(LONGLONG, longlong, ll)
-                            case PT_FLOAT:
-                                *((float*)ptr + j) = evaluated.f;
-                            case PT_DOUBLE:
-                                *((double*)ptr + j) = evaluated.d;
-                            default:
-                                error("Bad primitive type %d", evaluated.type.pt);
-                                return ERROR;
-                        }
+    if (!isPostfixUnaryToken(tk)) {
+        *toS = st;
+        return SUCCESS;
+    }
 
-                        #undef CASE
-                    }
-                    
-                    ve.st = (size) ptr;
-                }
-                else {
-                    Expression* expr = f->expr;
-                    ve.type = declType;
+    op = (UnaryOperatorType) tokenToPostfixOperator(tk);
+    next();
 
-                    if (expr != NULL) {
-                        ve = evaluateExpression(ctx, fChanges, expr);
-                        if (declType.pt != ve.type.pt || declType.pLevel != ve.type.pLevel) {
-                            ve = castTo(declType, &ve);
-                            if (probablyError(&ve)) {
-                                evalError("Cannot assign value to variable");
-                                return ERROR;
-                            }
-                        }
-                    }
+    err = parsePostfixOperators(prog, tk, expr, st, &st);
+    if (err != SUCCESS) return err;
+
+    newExpr = allocExpression(&prog->exprs, EXPR_UNARY);
+    if (newExpr == NULL) {
+        error("Memory allocation error");
+        return MALLOC_ERROR;
+    }
+    newExpr->ue.op = op;
+    newExpr->ue.expr = *expr;
+    *expr = exprId(&prog->exprs, newExpr);
+
+    *toS = st;
+    return SUCCESS;
+}
+
+// prefix operators and casts wrap their operand, which is parsed by recursion;
+// [] and postfix operators are applied to the operand before them
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseUnaryExpression(Program* prog, Token* tk, ExprId* toE, const Token* st, const Token** toS) {
+    Expression* newExpr;
+    ExprId expr;
+    int err;
+
+    if (match(TK_LPAREN)) {
+        if (isTypeBeginning(tk)) {
+            Type castType;
+
+            st = parseType(tk, &castType, st);
+            if (st == NULL) {
+                parserError("Cannot parse cast type");
+                return ERROR;
+            }
+            if (!match(TK_RPAREN)) {
+                errExp(TK_RPAREN);
+                return ERROR;
+            }
+
+            err = parseUnaryExpression(prog, tk, &expr, st, &st);
+            if (err != SUCCESS) return err;
+
+            newExpr = allocExpression(&prog->exprs, EXPR_CAST);
+            if (newExpr == NULL) {
+                error("Memory allocation error");
+                return MALLOC_ERROR;
+            }
+            newExpr->ce.expr = expr;
+            newExpr->ce.type = castType;
+            newExpr->ce.isImplicit = 0;
+
+            *toE = exprId(&prog->exprs, newExpr);
+            *toS = st;
+            return SUCCESS;
+        }
+
+        err = parseBracketsExpression(prog, tk, &expr, st, &st);
+        if (err != SUCCESS) return err;
+    }
+    else if (isPrefixUnaryToken(tk)) {
+        UnaryOperatorType op = (UnaryOperatorType) tokenToPrefixOperator(tk);
+
+        next();
+        err = parseUnaryExpression(prog, tk, &expr, st, &st);
+        if (err != SUCCESS) return err;
+
+        newExpr = allocExpression(&prog->exprs, EXPR_UNARY);
+        if (newExpr == NULL) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+        newExpr->ue.op = op;
+        newExpr->ue.expr = expr;
+
+        *toE = exprId(&prog->exprs, newExpr);
+        *toS = st;
+        return SUCCESS;
+    }
+    else {
+        err = parseSimpleExpression(prog, tk, &expr, st, &st);
+        if (err != SUCCESS) return err;
+    }
+
+    if (match(TK_LPAREN_SQ)) {
+        Expression* binary;
+        ExprId offset;
+
+        binary = allocExpression(&prog->exprs, EXPR_BINARY);
+        if (binary == NULL) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+
+        err = parseExpression(prog, tk, &offset, st, &st);
+        if (err != SUCCESS) return err;
+
+        binary->be.op = OPB_SQ_BRACKETS;
+        binary->be.expr1 = expr;
+        binary->be.expr2 = offset;
+
+        expr = exprId(&prog->exprs, binary);
+
+        if (!match(TK_RPAREN_SQ)) {
+            errExp(TK_RPAREN_SQ);
+            return ERROR;
+        }
+    }
+
+    err = parsePostfixOperators(prog, tk, &expr, st, &st);
+    if (err != SUCCESS) return err;
+
+    *toE = expr;
+    *toS = st;
+    return SUCCESS;
+}
+
+// precedence climbing: operators up to maxPriority are taken, smaller priority binds stronger.
+// Right operand of left associative operator takes only stronger ones
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseBinaryExpression(Program* prog, Token* tk, uint maxPriority, ExprId* toE, const Token* st, const Token** toS) {
+    ExprId left, right;
+    int err;
+
+    if (is(TK_END) || is(TK_RPAREN) || is(TK_COMMA)) {
+        parserError("No expression to pop");
+        return ERROR;
+    }
+
+    err = parseUnaryExpression(prog, tk, &left, st, &st);
+    if (err != SUCCESS) {
+        parserError("Cannot parse unary expression");
+        return err;
+    }
+
+    for (;;) {
+        Expression* expr;
+        OpPriority pr;
+        int op;
+
+        if (is(TK_END) || is(TK_RPAREN) || is(TK_COMMA) || is(TK_RPAREN_SQ) || is(TK_RBR)) break;
+
+        op = tokenToBinaryOrAssignmentOperator(tk);
+        if (op == -1) {
+            parserError("Bad binary operator `%.*s`", (int) tk->len, tk->text);
+            return ERROR;
+        }
+        pr = getOpPriority(op);
+        if (pr.priority > maxPriority) break;
+        next();
+
+        err = parseBinaryExpression(prog, tk, pr.isLeftAssoc ? pr.priority - 1 : pr.priority, &right, st, &st);
+        if (err != SUCCESS) return err;
+
+        expr = allocExpression(&prog->exprs, isBinary(op) ? EXPR_BINARY : EXPR_ASSIGNMENT);
+        if (expr == NULL) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+        if (isBinary(op)) {
+            expr->be.op = (BinaryOperatorType) op;
+            expr->be.expr1 = left;
+            expr->be.expr2 = right;
+        }
+        else {
+            expr->ae.op = (AssignmentOperatorType) op;
+            expr->ae.expr1 = left;
+            expr->ae.expr2 = right;
+        }
+        left = exprId(&prog->exprs, expr);
+    }
+
+    *toE = left;
+    *toS = st;
+    return SUCCESS;
+}
+
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseExpressionWithoutComma(Program* prog, Token* tk, ExprId* toE, const Token* st, const Token** toS) {
+    return parseBinaryExpression(prog, tk, getOpPriority(OPA_AT).priority, toE, st, toS);
+}
+
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseExpression(Program* prog, Token* tk, ExprId* toE, const Token* st, const Token** toS) {
+    ExprPool* pool = &prog->exprs;
+    Expression* commaExpr;
+    ExprId expr;
+    uint first = pool->pendingCount;
+    int err;
+
+    if ((err = parseExpressionWithoutComma(prog, tk, &expr, st, &st)) != SUCCESS) return err;
+
+    if (!is(TK_COMMA)) {
+        *toE = expr;
+        *toS = st;
+        return SUCCESS;
+    }
+
+    // items of nested lists are taken from pending ones before the next item is added
+    if (pushPendingItem(pool, expr) != SUCCESS) {
+        error("Cannot allocate memory");
+        return MALLOC_ERROR;
+    }
+
+    while (match(TK_COMMA)) {
+        err = parseExpressionWithoutComma(prog, tk, &expr, st, &st);
+        if (err != SUCCESS) return err;
+
+        if (pushPendingItem(pool, expr) != SUCCESS) {
+            error("Cannot allocate memory");
+            return MALLOC_ERROR;
+        }
+    }
+
+    commaExpr = allocExpression(pool, EXPR_COMMA);
+    if (commaExpr == NULL || takePendingItems(pool, first, &commaExpr->cme.exprs) != SUCCESS) {
+        error("Cannot allocate memory");
+        return MALLOC_ERROR;
+    }
+
+    *toE = exprId(pool, commaExpr);
+    *toS = st;
+    return SUCCESS;
+}
+
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+// fields are parsed to program buffer, declaration gets their copy of its size
+int parseVarDeclarationStatement(Program* prog, Token* tk, Statement* node, const Token* st) {
+    PrimitiveType pt;
+    int vAmount = 0, isUnsigned = 0;
+    VarDeclField* fld;
+
+    st = parseDeclarationType(tk, &pt, st);
+    if (st == NULL) {
+        parserError("Cannot parse type of variable declaration");
+        return ERROR;
+    }
+
+    node->type = ST_VARIABLE_DECLARATION;
+    node->vs.vType = pt;
+
+    fld = allocDeclField(prog, 0);
+    if (fld == NULL) {
+        error("Memory allocation error");
+        return MALLOC_ERROR;
+    }
+
+    for (;;) {
+        
+        while (match(TK_STAR)) fld->pLevel++;
+
+        if (!is(TK_ID)) {
+            errExp(TK_ID);
+            return ERROR;
+        }
+
+        fld->slot = symbolIntern(&prog->symbols, tk->text, tk->len);
+        if (fld->slot < 0) {
+            error("Memory allocation error");
+            return MALLOC_ERROR;
+        }
+        next();
+        
+        if (match(TK_LPAREN_SQ)) {
+            fld->isArray = 1;
+            if (match(TK_RPAREN_SQ));
+            else if (is(TK_INT_CONSTANT)) {
+                fld->arraySize = tk->iVal;
+                next();
+                if (!match(TK_RPAREN_SQ)) {
+                    errExp(TK_RPAREN_SQ);
+                    return ERROR;
                 }
-                var.v = ve;
-                strcpy(var.name, f->name);
-                regStatus = ctxRegisterVariable(ctx, var, &registeredVarPtr);
-                if (regStatus == MALLOC_ERROR) {
-                    error("Memory allocation error");
-                    return MALLOC_ERROR;
+            }
+            else {
+                parserError("Cannot parse [] after variable name");
+                return ERROR;
+            }
+        }
+
+        if (match(TK_EQ)) {
+            if (!fld->isArray) {
+                int err = parseExpressionWithoutComma(prog, tk, &fld->expr, st, &st);
+                if (err != SUCCESS) {
+                    parserError("Cannot parse expression in variable declaration");
+                    return err;
                 }
+            }
+            else {
+                uint first = prog->exprs.pendingCount;
+                int err;
 
-                dSize = sizeOf(var.v.type.pt);
-                if (dSize == 0) {
-                    evalError("Cannot get size of void type");
+                if (!match(TK_LBR)) {
+                    errExp(TK_LBR);
                     return ERROR;
                 }
 
-                if (ctxAddMemoryRegion(ctx, &registeredVarPtr->v.c, 
-                                       var.v.type.pLevel != 0 ? sizeof(size_t) : dSize
-                                      ) != SUCCESS) {
+                for (;;) {
+                    ExprId expr;
+
+                    if (is(TK_RBR)) break;
+
+                    err = parseExpressionWithoutComma(prog, tk, &expr, st, &st);
+                    if (err != SUCCESS) return err;
+
+                    if (pushPendingItem(&prog->exprs, expr) != SUCCESS) {
+                        error("Memory allocation error");
+                        return MALLOC_ERROR;
+                    }
+
+                    if (!match(TK_COMMA)) break;
+                }
+
+                if (takePendingItems(&prog->exprs, first, &fld->inits) != SUCCESS) {
                     error("Memory allocation error");
                     return MALLOC_ERROR;
                 }
-                
-                if (regStatus == ERROR) {
-                    evalError("Cannot register variable `%s`", f->name);
+
+                if (!match(TK_RBR)) {
+                    errExp(TK_RBR);
                     return ERROR;
                 }
             }
-            *fChanges = 1;
-            break;
-        case ST_EXPRESSION:
-            evaluateExpression(ctx, fChanges, statement->es.expr);
-            break;
-        case ST_PRINT: {
-            ValueExpression ve = evaluateExpression(ctx, fChanges, statement->ps.expr);
-            printValueExpression(&ve);
+        }
+        if (match(TK_COMMA)) {
+            fld = allocDeclField(prog, ++vAmount);
+            if (fld == NULL) {
+                error("Memory allocation error");
+                return MALLOC_ERROR;
+            }
+            continue;
+        }
+        if (is(TK_END)) {
             break;
         }
-        default:
-            error("Bad statement type %d", statement->type);
-            return ERROR;
     }
 
-    if (ctx->hasEvaluationError) return ERROR;
+    vAmount++;
+    node->vs.vAmount = vAmount;
+    node->vs.variables = (VarDeclField*) arenaAlloc(&prog->arena, vAmount * sizeof(VarDeclField));
+    if (node->vs.variables == NULL) {
+        error("Memory allocation error");
+        return MALLOC_ERROR;
+    }
+    memcpy(node->vs.variables, prog->declFields, vAmount * sizeof(VarDeclField));
     return SUCCESS;
 }
 
-#undef evalError
+int parseExpressionStatement(Program* prog, Token* tk, Statement* node, const Token* st) {
+    ExprId expr;
+    int err = parseExpression(prog, tk, &expr, st, &st);
 
-// Ret: NULL - no token detected, next s - success
-char* parseToken(Token* to, char* s) {
-    char* begin;
-    s = strskp(s);
-    begin = s;
+    if (err != SUCCESS) return err;
 
-    if (*s == 0) to->type = TK_END;
-    else if (isalpha(*s) || *s == '_') {
-        size l;
-        char* st = s;
-        s++;
-        while (isalpha(*s) || *s == '_' || isdigit(*s)) s++;
-
-        strncpy0(to->id, st, min(s - st + 1, ID_BUFF_SIZE));
-
-        if (strcmp(to->id, "void") == 0) to->type = TK_VOID;
-        else if (strcmp(to->id, "char") == 0) to->type = TK_CHAR;
-        else if (strcmp(to->id, "short") == 0) to->type = TK_SHORT;
-        else if (strcmp(to->id, "int") == 0) to->type = TK_INT;
-        else if (strcmp(to->id, "long") == 0) to->type = TK_LONG;
-        else if (strcmp(to->id, "float") == 0) to->type = TK_FLOAT;
-        else if (strcmp(to->id, "double") == 0) to->type = TK_DOUBLE;
-        else if (strcmp(to->id, "signed") == 0) to->type = TK_SIGNED;
-        else if (strcmp(to->id, "unsigned") == 0) to->type = TK_UNSIGNED;
-        else if (strcmp(to->id, "print") == 0) to->type = TK_PRINT;
-        else to->type = TK_ID;
-    }
-    else if (isdigit(*s) || *s == '.') {
-        char buff[ID_BUFF_SIZE];
-        char* start = s;
-        int isFloat = *s == '.';
-        
-        if (*s == '0' && *(s + 1) == 'x') {
-            start = s += 2;
-            while (isxdigit(*s)) s++;
+    node->type = ST_EXPRESSION;
+    node->es.expr = expr;
+    return SUCCESS;
+}
 
-            to->type = TK_INT_CONSTANT;
-            strncpy0(buff, start, min(s - start + 1, sizeof(buff)));
-            to->iVal = strtoll(buff, NULL, 16);
-        }
-        else {
-            s++;
-            while (isdigit(*s)) s++;
-            if (!isFloat && *s == '.') s++, isFloat = 1;
-            while (isdigit(*s)) s++;
-
-            strncpy0(buff, start, min(s - start + 1, sizeof(buff)));
-            if (isFloat) {
-                to->type = TK_FLOAT_CONSTANT;
-                to->fVal = atof(buff);
-            }
-            else {
-                to->type = TK_INT_CONSTANT;
-                to->iVal = atoll(buff);
-            }
-        }
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+// print ^ expr...;
+int parsePrintStatement(Program* prog, Token* tk, Statement* node, const Token* st) {
+    node->type = ST_PRINT;
+    if (parseExpression(prog, tk, &node->ps.expr, st, &st) != SUCCESS) {
+        parserError("Cannot parse expression after print");
+        return ERROR;
     }
-    else {
-        switch(*s) {
-            case SINGLE_QUOTE:
-                // TODO: parse char
-                error("Not implemented");
-                break;
-            case '"':
-                // TODO: parse string
-                error("Not implemented");
-                break;
-            case '+':
-                s++;
-                if (*s == '+') {
-                    s++;
-                    to->type = TK_PLUS_PLUS;
-                }
-                else if (*s == '=') {
-                    s++;
-                    to->type = TK_PLUS_EQ;
-                }
-                else to->type = TK_PLUS;
-                break;
-            case '-':
-                s++;
-                if (*s == '-') {
-                    s++;
-                    to->type = TK_MINUS_MINUS;
-                }
-                else if (*s == '=') {
-                    s++;
-                    to->type = TK_MINUS_EQ;
-                }
-                else to->type = TK_MINUS;
-                break;
-            case '*':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_STAR_EQ;
-                }
-                else to->type = TK_STAR;
-                break;
-            case '/':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_SLASH_EQ;
-                }
-                else to->type = TK_SLASH;
-                break;
-            case '%':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_PERCENT_EQ;
-                }
-                else to->type = TK_PERCENT;
-                break;
-            case '&':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_AMPERSAND_EQ;
-                }
-                else if (*s == '&') {
-                    s++;
-                    to->type = TK_AMPERSAND_AMPERSAND;
-                }
-                else to->type = TK_AMPERSAND;
-                break;
-            case '|':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_PIPE_EQ;
-                }
-                else if (*s == '|') {
-                    s++;
-                    to->type = TK_PIPE_PIPE;
-                }
-                else to->type = TK_PIPE;
-                break;
-            case '=':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_EQ_EQ;
-                }
-                else to->type = TK_EQ;
-                break;
-            case '!':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_NEQ;
-                }
-                else to->type = TK_EX_POINT;
-                break;
-            case '~':
-                s++;
-                to->type = TK_TILDE;
-                break;
-            case '<':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_LRE;
-                }
-                else if (*s == '<') {
-                    s++;
-                    if (*s == '=') {
-                        s++;
-                        to->type = TK_LR_LR_EQ;
-                    }
-                    else {
-                        to->type = TK_LR_LR;
-                    }
-                }
-                else to->type = TK_LR;
-                break;
-            case '>':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_GRE;
-                }
-                else if (*s == '>') {
-                    s++;
-                    if (*s == '=') {
-                        s++;
-                        to->type = TK_GR_GR_EQ;
-                    }
-                    else {
-                        to->type = TK_GR_GR;
-                    }
-                }
-                else to->type = TK_GR;
-                break;
-            case '^':
-                s++;
-                if (*s == '=') {
-                    s++;
-                    to->type = TK_CARET_EQ;
-                }
-                else to->type = TK_CARET;
-                break;
-            case ',':
-                s++;
-                to->type = TK_COMMA;
-                break;
-            case '(':
-                s++;
-                to->type = TK_LPAREN;
-                break;
-            case ')':
-                s++;
-                to->type = TK_RPAREN;
-                break;
-            case '[':
-                s++;
-                to->type = TK_LPAREN_SQ;
-                break;
-            case ']':
-                s++;
-                to->type = TK_RPAREN_SQ;
-                break;
-            case '{':
-                s++;
-                to->type = TK_LBR;
-                break;
-            case '}':
-                s++;
-                to->type = TK_RBR;
-                break;
+    return SUCCESS;
+}
 
-            default:
-                return NULL;
-        }
-        strncpy0(to->id, begin, s - begin + 1);
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+// fills statement allocated by caller
+int parseStatement(Program* prog, Statement* node, const Token* st) {
+    Token token;
+    Token* tk = &token;
+
+    next();
+
+    if (isTypeBeginning(tk)) {
+        return parseVarDeclarationStatement(prog, tk, node, st);
+    }
+    else if (match(TK_PRINT)) {
+        return parsePrintStatement(prog, tk, node, st);
     }
 
-    return s;
+    return parseExpressionStatement(prog, tk, node, st);
 }
 
-#define next() st = parseToken(tk, st), st != NULL
-#define match(t) (tk->type == t ? next(), 1 : 0)
-#define is(t) (tk->type == t)
-#define parserError(args...) { printf("Parser error: "); printf(args); puts(""); }
-#define errExp(T) parserError("Expected " #T)
+#undef is
+#undef match
+#undef next
+#undef parserError
+#undef errExp
 
-int parseExpression(Token* tk, Expression** toE, char* st, char** toS);
+// statement of len chars at input offset is added to the end of program, empty statement
+// ends the program. Position of parsing error is at prog->errorOffset
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseStatementText(Program* prog, char* statement, size_t len, size_t offset, int* isEnd) {
+    char* s;
+    Statement* node;
+    int err;
 
-int isPrefixUnaryToken(Token* tk) {
-    return is(TK_PLUS_PLUS) || is(TK_MINUS_MINUS) || is(TK_PLUS) || is(TK_MINUS) ||
-            is(TK_EX_POINT) || is(TK_TILDE) || is(TK_STAR) || is(TK_AMPERSAND);
-}
+    *isEnd = 1;
+    s = strskp(statement);
+    if (s == statement + len) return SUCCESS;
 
-int isPostfixUnaryToken(Token* tk) {
-    return is(TK_PLUS_PLUS) || is(TK_MINUS_MINUS);
+    *isEnd = 0;
+    node = allocStatement(prog);
+    if (node == NULL) {
+        error("Memory allocation error");
+        return MALLOC_ERROR;
+    }
+
+    if (lexStatement(prog, s) != SUCCESS) {
+        error("Memory allocation error");
+        return MALLOC_ERROR;
+    }
+    prog->errorToken = NULL;
+    err = parseStatement(prog, node, prog->tokens);
+    if (err != SUCCESS) {
+        prog->errorOffset = offset + ((prog->errorToken != NULL ? prog->errorToken : s) - statement);
+        return err;
+    }
+
+    node->codeOffset = offset + (s - statement);
+    node->codeLen = statement + len - s;
+    prog->statementCount++;
+    return SUCCESS;
 }
 
-int isTypeBeginning(Token* tk) {
-    return is(TK_UNSIGNED) || is(TK_SIGNED) || is(TK_VOID) || is(TK_CHAR) || 
-        is(TK_SHORT) || is(TK_INT) || is(TK_LONG) || is(TK_FLOAT) || is(TK_DOUBLE);
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseNextStatement(Program* prog, InputBuffer* from, int* isEnd) {
+    size_t len;
+    char* statement = inputNextStatement(from, &len);
+
+    *isEnd = 1;
+    if (statement == NULL) return from->error;
+    return parseStatementText(prog, statement, len, inputOffset(from, statement), isEnd);
 }
 
-// Ret: NULL is error, next s if success
-char* parseDeclarationType(Token* tk, PrimitiveType* to, char* st) {
-    struct {
-        uint isChar : 1;
-        uint isShort : 1;
-        uint isFloat : 1;
-        uint isDouble : 1;
-        uint isVoid : 1;
-    } t;
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parse(Program* prog, InputBuffer* from) {
+    for (;;) {
+        int isEnd;
+        int err = parseNextStatement(prog, from, &isEnd);
 
-    static_assert(sizeof(t) == sizeof(int), "Need change type");
+        if (err != SUCCESS) return err;
+        if (isEnd) break;
+    }
+    return SUCCESS;
+}
 
-    int* ti = (int*) &t;
-    int cntLong = 0;
-    int isUnsigned = 0;
-    int isSigned = 0;
-    int isInt = 0;
+// statements [first, end) of indexed input are parsed to own program by a thread,
+// then the part is moved to the end of the main program
+typedef struct {
+    Program prog;
+    const InputBuffer* in;
+    size_t first;
+    size_t end;
+    int status; // SUCCESS, ERROR, MALLOC_ERROR
+    int isEnd; // part has empty statement, so parts after it are dropped
+
+    // messages of parser are written when all previous parts are parsed
+    char* out;
+    size_t outLen;
+    char* err;
+    size_t errLen;
+
+    // where the part goes in the main program
+    Program* to;
+    int* slots; // slot of the part -> slot of the program
+    uint nodeShift;
+    uint itemShift;
+    int statementBase;
+} ParsePart;
 
-    *ti = 0;
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parsePart(ParsePart* part) {
+    for (size_t k = part->first; k < part->end; k++) {
+        size_t len;
+        char* statement = inputStatementAt(part->in, k, &len);
+        int err = parseStatementText(&part->prog, statement, len, inputOffset(part->in, statement), &part->isEnd);
+
+        if (err != SUCCESS) return err;
+        if (part->isEnd) break;
+    }
+    return SUCCESS;
+}
 
-    for (;;) {
-        if (match(TK_VOID)) { if (*ti) return NULL; t.isVoid = 1; }
-        else if (match(TK_CHAR)) { if (*ti) return NULL; t.isChar = 1; }
-        else if (match(TK_SHORT)) { if (*ti) return NULL; t.isShort = 1; }
-        else if (match(TK_INT)) { if (t.isChar || t.isFloat || t.isDouble || isInt) return NULL; isInt = 1; }
+void* parsePartWorker(void* arg) {
+    ParsePart* part = (ParsePart*) arg;
+
+    outStream = open_memstream(&part->out, &part->outLen);
+    errStream = open_memstream(&part->err, &part->errLen);
+    if (outStream == NULL || errStream == NULL) {
+        if (outStream != NULL) fclose(outStream), free(part->out);
+        if (errStream != NULL) fclose(errStream), free(part->err);
+        outStream = errStream = NULL;
+        part->out = part->err = NULL;
+        part->outLen = part->errLen = 0;
+        part->status = MALLOC_ERROR;
+        return NULL;
+    }
 
-        else if (match(TK_FLOAT)) { if (*ti || isInt) return NULL; t.isFloat = 1; }
-        else if (match(TK_DOUBLE)) { if (*ti || isInt) return NULL; t.isDouble = 1; }
+    part->status = parsePart(part);
 
-        else if (match(TK_UNSIGNED)) { if (isUnsigned || isSigned) return NULL; isUnsigned = 1; }
-        else if (match(TK_SIGNED)) { if (isSigned || isUnsigned) return NULL; isSigned = 1; }
+    fclose(outStream);
+    fclose(errStream);
+    outStream = errStream = NULL;
+    return NULL;
+}
 
-        else if (match(TK_LONG)) cntLong++;
-        else break;
+#define MOVE_ID(id) { if ((id) != 0) (id) += nodeShift; }
+
+// ids of the part are shifted to its place in the main program, slots are mapped
+void relocateExpression(Expression* e, uint nodeShift, uint itemShift, const int* slots) {
+    switch (e->type) {
+        case EXPR_ASSIGNMENT:
+            MOVE_ID(e->ae.expr1);
+            MOVE_ID(e->ae.expr2);
+            break;
+        case EXPR_CAST:
+            MOVE_ID(e->ce.expr);
+            break;
+        case EXPR_UNARY:
+            MOVE_ID(e->ue.expr);
+            break;
+        case EXPR_BINARY:
+            MOVE_ID(e->be.expr1);
+            MOVE_ID(e->be.expr2);
+            break;
+        case EXPR_VARIABLE:
+            e->ve.slot = slots[e->ve.slot];
+            break;
+        case EXPR_COMMA:
+            e->cme.exprs.first += itemShift;
+            break;
+        default:
+            break;
     }
+}
 
-    if (t.isVoid) {
-        if (cntLong != 0) return NULL;
-        if (isUnsigned != 0) return NULL;
-        if (isSigned != 0) return NULL;
-        if (isInt != 0) return NULL;
+// nodes, items and statements of the part are copied to places reserved in the main program
+void* appendPartWorker(void* arg) {
+    ParsePart* part = (ParsePart*) arg;
+    const ExprPool* from = &part->prog.exprs;
+    ExprPool* to = &part->to->exprs;
+    uint nodeShift = part->nodeShift, itemShift = part->itemShift;
 
-        *to = PT_VOID;
-        return st;
+    for (uint i = 1; i < from->nodeCount; i++) {
+        Expression* e = exprAt(to, i + nodeShift);
+
+        *e = *exprAt(from, i);
+        relocateExpression(e, nodeShift, itemShift, part->slots);
     }
-    if (t.isChar) {
-        if (cntLong != 0) return NULL;
-        if (isUnsigned) {
-            *to = PT_UCHAR;
-            return st;
-        }
-        *to = PT_CHAR;
-        return st;
+    for (uint i = 0; i < from->itemCount; i++) {
+        to->items[i + itemShift] = from->items[i] + nodeShift;
     }
-    if (t.isShort) {
-        if (cntLong != 0) return NULL;
-        if (isUnsigned) {
-            *to = PT_USHORT;
-            return st;
+
+    for (int i = 0; i < part->prog.statementCount; i++) {
+        Statement* st = &part->to->statements[part->statementBase + i];
+
+        *st = part->prog.statements[i];
+        switch (st->type) {
+            case ST_VARIABLE_DECLARATION:
+                // fields are in arena of the part, it is given to the main program
+                for (int j = 0; j < st->vs.vAmount; j++) {
+                    VarDeclField* f = &st->vs.variables[j];
+
+                    f->slot = part->slots[f->slot];
+                    if (f->isArray) f->inits.first += itemShift;
+                    else MOVE_ID(f->expr);
+                }
+                break;
+            case ST_EXPRESSION:
+                MOVE_ID(st->es.expr);
+                break;
+            case ST_PRINT:
+                MOVE_ID(st->ps.expr);
+                break;
         }
-        *to = PT_SHORT;
-        return st;
     }
-    if (t.isFloat) {
-        if (isUnsigned != 0) return NULL;
-        if (isSigned != 0) return NULL;
+    return NULL;
+}
 
-        if (cntLong == 0) {
-            *to = PT_FLOAT;
-            return st;
-        }
-        if (cntLong >= 1) {
-            *to = PT_DOUBLE;
-            return st;
+#undef MOVE_ID
+
+// chunks of the part are put after the current chunk of the main arena, which stays the current one
+void arenaAppend(Arena* to, Arena* from) {
+    ArenaChunk* last = from->chunks;
+
+    if (last == NULL) return;
+    while (last->next != NULL) last = last->next;
+
+    if (to->chunks == NULL) {
+        to->chunks = from->chunks;
+    }
+    else {
+        last->next = to->chunks->next;
+        to->chunks->next = from->chunks;
+    }
+    from->chunks = NULL;
+}
+
+// names of the part are interned in order, so slots are the same as for parsing in one thread;
+// places for nodes, items and statements of the part are reserved
+// Ret: SUCCESS, MALLOC_ERROR
+int reservePart(Program* prog, ParsePart* part) {
+    const SymbolTable* names = &part->prog.symbols;
+    const ExprPool* pool = &part->prog.exprs;
+    uint nodeCount = pool->nodes != NULL ? pool->nodeCount - 1 : 0;
+
+    part->to = prog;
+    part->slots = (int*) malloc((names->count + 1) * sizeof(int));
+    if (part->slots == NULL) return MALLOC_ERROR;
+
+    for (int i = 0; i < names->count; i++) {
+        part->slots[i] = symbolIntern(&prog->symbols, names->names[i], strlen(names->names[i]));
+        if (part->slots[i] < 0) return MALLOC_ERROR;
+    }
+
+    if (exprPoolMap(&prog->exprs) != SUCCESS) return MALLOC_ERROR;
+    if (nodeCount > EXPR_POOL_MAX_NODES - prog->exprs.nodeCount) return MALLOC_ERROR;
+    if (pool->itemCount > EXPR_POOL_MAX_ITEMS - prog->exprs.itemCount) return MALLOC_ERROR;
+
+    part->nodeShift = prog->exprs.nodeCount - 1;
+    part->itemShift = prog->exprs.itemCount;
+    prog->exprs.nodeCount += nodeCount;
+    prog->exprs.itemCount += pool->itemCount;
+
+    part->statementBase = prog->statementCount;
+    prog->statementCount += part->prog.statementCount;
+    return SUCCESS;
+}
+
+// indexed input is split to parts of about the same size, one part per thread.
+// Messages of parser and the result are the same as for parse
+// Ret: SUCCESS, ERROR, MALLOC_ERROR
+int parseParallel(Program* prog, InputBuffer* in, int threadCount) {
+    ParsePart* parts;
+    pthread_t* threads;
+    size_t statementCount;
+    int partCount, usedCount, started = 0, err = SUCCESS;
+
+    if (in->delims == NULL) return parse(prog, in);
+
+    partCount = min((size_t) threadCount, in->size / PARSE_PART_MIN_SIZE);
+    if (partCount <= 1) return parse(prog, in);
+
+    statementCount = inputStatementCount(in);
+    parts = (ParsePart*) calloc(partCount, sizeof(ParsePart));
+    threads = (pthread_t*) malloc(partCount * sizeof(pthread_t));
+    if (parts == NULL || threads == NULL) {
+        free(parts);
+        free(threads);
+        error("Memory allocation error");
+        return MALLOC_ERROR;
+    }
+
+    // part t begins with the statement which contains byte t * size / partCount
+    for (int t = 0; t < partCount; t++) {
+        size_t at = in->size / partCount * t, lo = 0, hi = in->delimCount;
+
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (in->delims[mid] < at) lo = mid + 1;
+            else hi = mid;
         }
 
-        error("Error cannot be there");
-        return NULL;
+        initProgram(&parts[t].prog);
+        parts[t].in = in;
+        parts[t].first = t == 0 ? 0 : max(lo, parts[t - 1].first);
+        if (t != 0) parts[t - 1].end = parts[t].first;
     }
-    if (t.isDouble) {
-        if (isUnsigned != 0) return NULL;
-        if (isSigned != 0) return NULL;
+    parts[partCount - 1].end = statementCount;
 
-        *to = PT_DOUBLE;
-        return st;
+    for (; started < partCount; started++) {
+        if (pthread_create(&threads[started], NULL, parsePartWorker, &parts[started]) != 0) break;
     }
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    for (int t = started; t < partCount; t++) parsePartWorker(&parts[t]);
 
-    if (cntLong == 1) {
-        if (isUnsigned) {
-            *to = PT_ULONG;
-            return st;
+    // parts up to the first failed or ended one make the program
+    for (usedCount = 0; usedCount < partCount; ) {
+        ParsePart* part = &parts[usedCount];
+
+        fwrite(part->out, 1, part->outLen, OUT_STREAM);
+        fwrite(part->err, 1, part->errLen, ERR_STREAM);
+
+        err = part->status;
+        if (err == ERROR) prog->errorOffset = part->prog.errorOffset;
+        if (err == SUCCESS) err = reservePart(prog, part);
+        if (err != SUCCESS) break;
+
+        usedCount++;
+        if (part->isEnd) break;
+    }
+
+    if (err == SUCCESS && prog->statementCount > prog->statementCapacity) {
+        Statement* statements = (Statement*) realloc(prog->statements, prog->statementCount * sizeof(Statement));
+
+        if (statements == NULL) err = MALLOC_ERROR;
+        else {
+            prog->statements = statements;
+            prog->statementCapacity = prog->statementCount;
         }
-        *to = PT_LONG;
-        return st;
     }
-    if (cntLong >= 2) {
-        if (isUnsigned) {
-            *to = PT_ULONGLONG;
-            return st;
+    if (err == MALLOC_ERROR) error("Memory allocation error");
+
+    if (err == SUCCESS) {
+        for (started = 0; started < usedCount; started++) {
+            if (pthread_create(&threads[started], NULL, appendPartWorker, &parts[started]) != 0) break;
         }
-        *to = PT_LONGLONG;
-        return st;
+        for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+        for (int t = started; t < usedCount; t++) appendPartWorker(&parts[t]);
+
+        for (int t = 0; t < usedCount; t++) arenaAppend(&prog->arena, &parts[t].prog.arena);
     }
 
-    *to = PT_INT;
-    return st;
+    for (int t = 0; t < partCount; t++) {
+        free(parts[t].out);
+        free(parts[t].err);
+        free(parts[t].slots);
+        freeProgram(&parts[t].prog);
+    }
+    free(parts);
+    free(threads);
+    return err;
 }
 
-char* parseType(Token* tk, Type* to, char* st) {
+// Image is the resolved program as it is in memory, for the build which saved it. Nodes and
+// items are mapped into the expression pool at their ids, so the AST is not relocated.
+// Statements are mapped with the rest of the file, their fields and packed values of arrays are
+// saved as offsets. Source of the program is saved as well, statements are printed from it
+#define IMAGE_MAGIC "CLIIMAGE"
+#define IMAGE_VERSION 3
+#define IMAGE_ALIGN (1 << 16)
+
+#define imageAlign(n) (((n) + IMAGE_ALIGN - 1) & ~(ulonglong) (IMAGE_ALIGN - 1))
+#define imageAlignValue(n) (((n) + sizeof(ulonglong) - 1) & ~(ulonglong) (sizeof(ulonglong) - 1))
+
+// text holds terminated names of slots and then the source
+typedef struct {
+    char magic[8];
+    uint version;
+    uint exprSize, statementSize, fieldSize; // layout of the build
+    uint nodeCount;
+    uint itemCount;
+    int statementCount;
+    int fieldCount;
+    int symbolCount;
+    ulonglong nodesOffset, itemsOffset, statementsOffset, fieldsOffset, valuesOffset, textOffset, sourceOffset, size;
+} ImageHeader;
+
+// Ret: bytes of packed values of array field
+size_t fieldValuesSize(const VarDeclStatement* vs, const VarDeclField* f) {
     Type t;
-    
-    st = parseDeclarationType(tk, &t.pt, st);
-    if (st == NULL) return NULL;
+    t.pt = vs->vType;
+    t.pLevel = f->pLevel;
+    return f->isArray && f->values != NULL ? imageAlignValue((size_t) f->inits.count * valueWidth(t)) : 0;
+}
 
-    t.pLevel = 0;
+// Ret: SUCCESS, ERROR
+int imageWrite(FILE* f, ulonglong* pos, const void* data, size_t n) {
+    if (n != 0 && fwrite(data, 1, n, f) != n) return ERROR;
+    *pos += n;
+    return SUCCESS;
+}
 
-    while (match(TK_STAR)) t.pLevel++;
-    *to = t;
+// file is filled with zeros up to offset
+// Ret: SUCCESS, ERROR
+int imagePad(FILE* f, ulonglong* pos, ulonglong offset) {
+    static const char zeros[256];
 
-    return st;
+    while (*pos < offset) {
+        if (imageWrite(f, pos, zeros, min(offset - *pos, sizeof(zeros))) != SUCCESS) return ERROR;
+    }
+    return SUCCESS;
 }
 
-// parse: ( ^ expr...)
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-int parseBracketsExpression(Token* tk, Expression** toE, char* st, char** toS) {
-    Expression* expr;
-    int err = parseExpression(tk, &expr, st, &st);
-    if (err != SUCCESS) return err;
+// program is resolved and not compiled, whole input is in buffer
+// Ret: SUCCESS, ERROR - cannot write file
+int saveImage(const Program* prog, const InputBuffer* in, const char* path) {
+    ImageHeader h;
+    ulonglong pos = 0, namesSize = 0, valuesSize = 0, valuesPos;
+    int fieldPos = 0, err = SUCCESS;
+    FILE* f;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMAGE_MAGIC, sizeof(h.magic));
+    h.version = IMAGE_VERSION;
+    h.exprSize = sizeof(Expression);
+    h.statementSize = sizeof(Statement);
+    h.fieldSize = sizeof(VarDeclField);
+    h.nodeCount = prog->exprs.nodes != NULL ? prog->exprs.nodeCount : 0;
+    h.itemCount = prog->exprs.itemCount;
+    h.statementCount = prog->statementCount;
+    h.symbolCount = prog->symbols.count;
+
+    for (int i = 0; i < prog->symbols.count; i++) namesSize += strlen(prog->symbols.names[i]) + 1;
+    for (int i = 0; i < prog->statementCount; i++) {
+        const Statement* st = &prog->statements[i];
+
+        if (st->type != ST_VARIABLE_DECLARATION) continue;
+        h.fieldCount += st->vs.vAmount;
+        for (int j = 0; j < st->vs.vAmount; j++) valuesSize += fieldValuesSize(&st->vs, &st->vs.variables[j]);
+    }
 
-    if (!match(TK_RPAREN)) {
-        errExp(TK_RPAREN);
-        freeExpression(expr);
+    h.nodesOffset = imageAlign(sizeof(h));
+    h.itemsOffset = imageAlign(h.nodesOffset + (ulonglong) h.nodeCount * sizeof(Expression));
+    h.statementsOffset = imageAlign(h.itemsOffset + (ulonglong) h.itemCount * sizeof(ExprId));
+    h.fieldsOffset = h.statementsOffset + (ulonglong) h.statementCount * sizeof(Statement);
+    h.valuesOffset = imageAlignValue(h.fieldsOffset + (ulonglong) h.fieldCount * sizeof(VarDeclField));
+    h.textOffset = h.valuesOffset + valuesSize;
+    h.sourceOffset = h.textOffset + namesSize;
+    h.size = h.sourceOffset + in->size;
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        error("Cannot open image `%s`: %s", path, strerror(errno));
         return ERROR;
     }
 
-    *toE = expr;
-    *toS = st;
-    return SUCCESS;
-}
+    err |= imageWrite(f, &pos, &h, sizeof(h));
+    err |= imagePad(f, &pos, h.nodesOffset);
+    err |= imageWrite(f, &pos, prog->exprs.nodes, h.nodeCount * sizeof(Expression));
+    err |= imagePad(f, &pos, h.itemsOffset);
+    err |= imageWrite(f, &pos, prog->exprs.items, h.itemCount * sizeof(ExprId));
+    err |= imagePad(f, &pos, h.statementsOffset);
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-// parse: ValueExpression & VariableExpression
-int parseSimpleExpression(Token* tk, Expression** toE, char* st, char** toS) {
-    Expression* expr;
-    int err;
+    for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+        Statement st = prog->statements[i];
 
-    if (is(TK_ID)) {
-        expr = allocExpression(EXPR_VARIABLE);
-        if (expr == NULL) {
-            error("Memory allocation error");
-            return MALLOC_ERROR;
+        if (st.type == ST_VARIABLE_DECLARATION) {
+            st.vs.variables = (VarDeclField*) (size_t) fieldPos;
+            fieldPos += st.vs.vAmount;
         }
-        strcpy(expr->ve.name, tk->id);
-        next();
+        err |= imageWrite(f, &pos, &st, sizeof(st));
     }
-    else if (is(TK_INT_CONSTANT)) {
-        expr = allocExpression(EXPR_VALUE);
-        if (expr == NULL) {
-            error("Memory allocation error");
-            return MALLOC_ERROR;
+    valuesPos = h.valuesOffset;
+    for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+        const Statement* st = &prog->statements[i];
+
+        if (st->type != ST_VARIABLE_DECLARATION) continue;
+        for (int j = 0; j < st->vs.vAmount; j++) {
+            VarDeclField fld = st->vs.variables[j];
+
+            if (fld.isArray && fld.values != NULL) {
+                fld.values = (void*) (size_t) valuesPos;
+                valuesPos += fieldValuesSize(&st->vs, &st->vs.variables[j]);
+            }
+            err |= imageWrite(f, &pos, &fld, sizeof(fld));
         }
-        expr->vle.type.pLevel = 0;
-        expr->vle.type.pt = PT_LONGLONG;
-        expr->vle.ll = tk->iVal;
-        next();
     }
-    else if (is(TK_FLOAT_CONSTANT)) {
-        expr = allocExpression(EXPR_VALUE);
-        if (expr == NULL) {
-            error("Memory allocation error");
-            return MALLOC_ERROR;
+    err |= imagePad(f, &pos, h.valuesOffset);
+    for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+        const Statement* st = &prog->statements[i];
+
+        if (st->type != ST_VARIABLE_DECLARATION) continue;
+        for (int j = 0; j < st->vs.vAmount && err == SUCCESS; j++) {
+            const VarDeclField* fld = &st->vs.variables[j];
+            size_t n = fieldValuesSize(&st->vs, fld);
+
+            if (n == 0) continue;
+            err |= imageWrite(f, &pos, fld->values, n);
         }
-        expr->vle.type.pLevel = 0;
-        expr->vle.type.pt = PT_DOUBLE;
-        expr->vle.d = tk->fVal;
-        next();
     }
-    else {
+    for (int i = 0; i < prog->symbols.count && err == SUCCESS; i++) {
+        err |= imageWrite(f, &pos, prog->symbols.names[i], strlen(prog->symbols.names[i]) + 1);
+    }
+    if (err == SUCCESS) err = imageWrite(f, &pos, in->data, in->size);
+
+    if (fclose(f) != 0) err = ERROR;
+    if (err != SUCCESS) {
+        error("Cannot write image `%s`", path);
         return ERROR;
     }
-    
+    return SUCCESS;
+}
 
-    *toE = expr;
-    *toS = st;
+// section is mapped over the pool, it is copied when pages are bigger than image alignment
+// Ret: SUCCESS, ERROR
+int imageMapSection(void* to, int fd, const char* image, ulonglong offset, size_t n) {
+    if (n == 0) return SUCCESS;
+    if (IMAGE_ALIGN % sysconf(_SC_PAGESIZE) != 0) {
+        memcpy(to, image + offset, n);
+        return SUCCESS;
+    }
+    if (mmap(to, imageAlign(n), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) {
+        return ERROR;
+    }
     return SUCCESS;
 }
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-int parseUnaryExpression(Token* tk, Expression** toE, char* st, char** toS, 
-                        StackMathToken* prefixStack, StackMathToken* postfixStack) {
-    Expression* expr = NULL;
-    MathToken mt;
-    int err;
+// layout is checked, the AST is trusted as it was made by the same build
+// Ret: SUCCESS, ERROR - image cannot be used
+int checkImageHeader(const ImageHeader* h, size_t size) {
+    ulonglong nodesSize = (ulonglong) h->nodeCount * sizeof(Expression);
+    ulonglong itemsSize = (ulonglong) h->itemCount * sizeof(ExprId);
+
+    if (size < sizeof(*h) || memcmp(h->magic, IMAGE_MAGIC, sizeof(h->magic)) != 0) return ERROR;
+    if (h->version != IMAGE_VERSION || h->exprSize != sizeof(Expression) ||
+        h->statementSize != sizeof(Statement) || h->fieldSize != sizeof(VarDeclField)) return ERROR;
+    if (h->size != size || h->nodeCount > EXPR_POOL_MAX_NODES || h->itemCount > EXPR_POOL_MAX_ITEMS) return ERROR;
+    if (h->statementCount < 0 || h->fieldCount < 0 || h->symbolCount < 0) return ERROR;
+
+    if (h->nodesOffset != imageAlign(sizeof(*h)) ||
+        h->itemsOffset != imageAlign(h->nodesOffset + nodesSize) ||
+        h->statementsOffset != imageAlign(h->itemsOffset + itemsSize) ||
+        h->fieldsOffset != h->statementsOffset + (ulonglong) h->statementCount * sizeof(Statement) ||
+        h->valuesOffset != imageAlignValue(h->fieldsOffset + (ulonglong) h->fieldCount * sizeof(VarDeclField)) ||
+        h->textOffset < h->valuesOffset ||
+        h->sourceOffset < h->textOffset || h->sourceOffset > size) return ERROR;
+
+    // names end with terminated string
+    if (h->sourceOffset != h->textOffset && ((const char*) h)[h->sourceOffset - 1] != 0) return ERROR;
+    return SUCCESS;
+}
 
-    #define EXIT_ERROR { if (expr != NULL) freeExpression(expr); return err; }
+// names are restored from the text, fields of statements are relocated in place
+// Ret: SUCCESS, ERROR - image cannot be used, MALLOC_ERROR
+int restoreImage(Program* prog, const ImageHeader* h) {
+    char* text = prog->image + h->textOffset;
+    VarDeclField* fields = (VarDeclField*) (prog->image + h->fieldsOffset);
+    size_t namesSize = h->sourceOffset - h->textOffset, textPos = 0;
 
-    for (;;) {
-        if (match(TK_LPAREN)) {
-            if (isTypeBeginning(tk)) {
-                mt.op = OPP_CAST;
-                st = parseType(tk, &mt.castType, st);
-                if (st == NULL) {
-                    err = ERROR;
-                    parserError("Cannot parse cast type");
-                    EXIT_ERROR;
-                }
+    for (int i = 0; i < h->symbolCount; i++) {
+        size_t len;
 
-                err = stackPushMathToken(prefixStack, &mt);
-                if (err != SUCCESS) {
-                    error("Memory allocation error");
-                    EXIT_ERROR;
-                }
+        if (textPos >= namesSize) return ERROR;
+        len = strlen(text + textPos);
+        if (symbolIntern(&prog->symbols, text + textPos, len) != i) {
+            return prog->symbols.count == i ? MALLOC_ERROR : ERROR;
+        }
+        textPos += len + 1;
+    }
 
-                if (!match(TK_RPAREN)) {
-                    err = ERROR;
-                    errExp(TK_RPAREN);
-                    EXIT_ERROR;
-                }
-            }
-            else {
-                err = parseBracketsExpression(tk, &expr, st, &st);
-                if (err != SUCCESS) EXIT_ERROR;
+    prog->statements = (Statement*) (prog->image + h->statementsOffset);
+    prog->statementCount = prog->statementCapacity = h->statementCount;
+    for (int i = 0; i < h->statementCount; i++) {
+        Statement* st = &prog->statements[i];
 
-                break;
+        if (st->codeOffset + st->codeLen > h->size - h->sourceOffset) return ERROR;
+
+        if (st->type == ST_VARIABLE_DECLARATION) {
+            size_t first = (size_t) st->vs.variables;
+
+            if (st->vs.vAmount < 0 || first + st->vs.vAmount > (size_t) h->fieldCount) return ERROR;
+            st->vs.variables = fields + first;
+
+            for (int j = 0; j < st->vs.vAmount; j++) {
+                VarDeclField* f = &st->vs.variables[j];
+                size_t offset = (size_t) f->values, n = fieldValuesSize(&st->vs, f);
+
+                if (n == 0) continue;
+                if (offset < h->valuesOffset || offset + n > h->textOffset) return ERROR;
+                f->values = prog->image + offset;
             }
-            continue;
         }
-        if (isPrefixUnaryToken(tk)) {
-            mt.op = tokenToPrefixOperator(tk);
-            if (mt.op == -1) {
-                err = ERROR;
-                parserError("Cannot get prefix operator");
-                EXIT_ERROR;
-            }
-            // not need to set priority
-            err = stackPushMathToken(prefixStack, &mt);
-            if (err != SUCCESS) {
-                parserError("Cannot push unary token");
-                EXIT_ERROR;
+        else if (st->type != ST_EXPRESSION && st->type != ST_PRINT) return ERROR;
+    }
+    return SUCCESS;
+}
+
+// program is ready to be compiled and run, it stays in the image until freeProgram.
+// Source is given as input which is not closed
+// Ret: SUCCESS, ERROR - cannot read image, MALLOC_ERROR
+int loadImage(Program* prog, const char* path, InputBuffer* source) {
+    struct stat sb;
+    const ImageHeader* h;
+    int err, fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &sb) != 0) {
+        error("Cannot open image `%s`: %s", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return ERROR;
+    }
+    if ((size_t) sb.st_size < sizeof(ImageHeader)) {
+        error("Image `%s` is not valid", path);
+        close(fd);
+        return ERROR;
+    }
+
+    prog->image = (char*) mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (prog->image == MAP_FAILED) {
+        prog->image = NULL;
+        error("Cannot map image `%s`: %s", path, strerror(errno));
+        close(fd);
+        return ERROR;
+    }
+    prog->imageSize = sb.st_size;
+    h = (const ImageHeader*) prog->image;
+
+    err = checkImageHeader(h, sb.st_size);
+    if (err == SUCCESS) {
+        err = exprPoolMap(&prog->exprs);
+        if (err == SUCCESS) {
+            if (imageMapSection(prog->exprs.nodes, fd, prog->image, h->nodesOffset, h->nodeCount * sizeof(Expression)) != SUCCESS ||
+                imageMapSection(prog->exprs.items, fd, prog->image, h->itemsOffset, h->itemCount * sizeof(ExprId)) != SUCCESS) {
+                err = MALLOC_ERROR;
             }
-            next();
-            continue;
+            prog->exprs.nodeCount = max(h->nodeCount, 1);
+            prog->exprs.itemCount = h->itemCount;
         }
-        break;
     }
+    if (err == SUCCESS) err = restoreImage(prog, h);
+    close(fd);
 
-    if (expr == NULL) {
-        err = parseSimpleExpression(tk, &expr, st, &st);
-        if (err != SUCCESS) EXIT_ERROR;
+    memset(source, 0, sizeof(*source));
+    if (err == SUCCESS) {
+        source->data = prog->image + h->sourceOffset;
+        source->size = source->pos = h->size - h->sourceOffset;
     }
 
-    if (match(TK_LPAREN_SQ)) {
-        Expression* binary,* offset;
-        binary = allocExpression(EXPR_BINARY);
-        if (binary == NULL) {
-            error("Memory allocation error");
-            err = MALLOC_ERROR;
-            EXIT_ERROR;
-        }
+    if (err == ERROR) error("Image `%s` is not valid", path);
+    if (err == MALLOC_ERROR) error("Memory allocation error");
+    return err;
+}
 
-        err = parseExpression(tk, &offset, st, &st);
-        if (err != SUCCESS) {
-            free(binary);
-            EXIT_ERROR;
-        }
+// statement is printed from the input when it changes values, failed statement ends the program
+// Ret: SUCCESS, ERROR - evaluation error, MALLOC_ERROR
+int executeStatement(Context* ctx, const InputBuffer* in, Statement* st) {
+    int fChg = 0;
+    int err = interpretStatement(&fChg, ctx, st);
 
-        binary->be.op = OPB_SQ_BRACKETS;
-        binary->be.expr1 = expr;
-        binary->be.expr2 = offset;
+    if (err == MALLOC_ERROR) return MALLOC_ERROR;
 
-        expr = binary;
+    if (ctx->hasEvaluationError) {
+        uint line, column;
 
-        if (!match(TK_RPAREN_SQ)) {
-            errExp(TK_RPAREN_SQ);
-            err = ERROR;
-            EXIT_ERROR;
-        }
+        inputPosition(in, st->codeOffset, &line, &column);
+        outPrintf("Error occurred in the line %u, column %u:\n", line, column);
+        outPrintf("%.*s;\n", (int) st->codeLen, inputAt(in, st->codeOffset));
+        return ERROR;
     }
 
-    while (isPostfixUnaryToken(tk)) {
-        mt.op = tokenToPostfixOperator(tk);
-        if (mt.op == -1) {
-            err = ERROR;
-            parserError("Cannot get postfix operator");
-            EXIT_ERROR;
-        }
-        // not need to set priority
-        err = stackPushMathToken(postfixStack, &mt);
-        if (err != SUCCESS) {
-            parserError("Cannot push unary token");
-            EXIT_ERROR;
-        }
-        next();
+    if (fChg) {
+        outPrintf("%.*s;\n", (int) st->codeLen, inputAt(in, st->codeOffset));
     }
+    return SUCCESS;
+}
 
-    while (stackPopMathToken(postfixStack, &mt) == SUCCESS) {
-        Expression* newExpr = allocExpression(EXPR_UNARY);
-        if (newExpr == NULL) {
-            err = MALLOC_ERROR;
-            error("Memory allocation error");
-            EXIT_ERROR;
-        }
-        newExpr->ue.op = (UnaryOperatorType) mt.op;
-        newExpr->ue.expr = expr;
-        expr = newExpr;
+void printParsingError(const InputBuffer* in, const Program* prog) {
+    uint line, column;
+
+    inputPosition(in, prog->errorOffset, &line, &column);
+    outPrintf("\n====== ERROR ======\n");
+    outPrintf("Ends with parsing error in the line %u, column %u\n", line, column);
+}
+
+// every statement is executed as soon as it is parsed and its AST is dropped after it,
+// so memory doesn't grow with length of the program
+// Ret: SUCCESS - input ended or statement failed, ERROR - parsing error, MALLOC_ERROR
+int runStream(Program* prog, InputBuffer* in, Context* ctx) {
+    Preparer p;
+    int err;
+
+    if (initPreparer(&p, prog) != SUCCESS) {
+        freePreparer(&p);
+        return MALLOC_ERROR;
     }
 
-    while (stackPopMathToken(prefixStack, &mt) == SUCCESS) {
-        Expression* newExpr = allocExpression(mt.op != OPP_CAST ? EXPR_UNARY : EXPR_CAST);
-        if (newExpr == NULL) {
+    outPrintf("\n======= OUT =======\n\n");
+    fflush(stdout);
+
+    for (;;) {
+        int isEnd;
+
+        err = parseNextStatement(prog, in, &isEnd);
+        if (err != SUCCESS || isEnd) break;
+
+        if (prog->symbols.count > ctx->varCount) {
+            error("Too many variables for stream");
             err = MALLOC_ERROR;
-            error("Memory allocation error");
-            EXIT_ERROR;
-        }
-        if (mt.op != OPP_CAST) {
-            newExpr->ue.op = (UnaryOperatorType) mt.op;
-            newExpr->ue.expr = expr;
+            break;
         }
-        else {
-            newExpr->ce.expr = expr;
-            newExpr->ce.type = mt.castType;
+        err = prepareStatement(&p, prog, &prog->statements[0]);
+        if (err != SUCCESS) break;
+
+        err = executeStatement(ctx, in, &prog->statements[0]);
+        fflush(stdout);
+        if (err != SUCCESS) {
+            if (err == ERROR) err = SUCCESS;
+            break;
         }
-        expr = newExpr;
-    }
 
-    *toE = expr;
-    *toS = st;
-    return SUCCESS;
+        prog->statementCount = 0;
+        arenaReset(&prog->arena);
+        resetExprPool(&prog->exprs);
+    }
 
-    #undef EXIT_ERROR
+    if (err == SUCCESS && !ctx->hasEvaluationError) {
+        outPrintf("\n===== SUCCESS =====\n");
+    }
+    freePreparer(&p);
+    return err;
 }
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-int parseExpressionWithoutComma(Token* tk, Expression** toE, char* st, char** toS) {
-
-    #define EXIT_ERROR { freeStackExpression(&exprStack); freeStackMathToken(&opStack); \
-                         freeStackMathToken(&unaryStack1); freeStackMathToken(&unaryStack2); return ERROR; }
-    StackExpression exprStack;
-    StackMathToken opStack, unaryStack1, unaryStack2;
-
-    MathToken mt;
+// program which ends with empty statement is printed as separate program n.
+// Context and other storage are reset after it, not allocated again
+// Ret: SUCCESS, MALLOC_ERROR
+int runBatchProgram(Program* prog, InputBuffer* in, Context* ctx, Preparer* p, int n) {
     int err;
 
-    err = stackInitMathToken(&opStack, OPERATOR_STACK_START_CAP);
-    if (err != SUCCESS) {
-        error("Memory allocation error");
-        return err;
-    }
-    err = stackInitMathToken(&unaryStack1, OPERATOR_STACK_START_CAP);
-    if (err != SUCCESS) {
-        error("Memory allocation error");
-        freeStackMathToken(&opStack);
-        return err;
-    }
-    err = stackInitMathToken(&unaryStack2, OPERATOR_STACK_START_CAP);
-    if (err != SUCCESS) {
-        error("Memory allocation error");
-        freeStackMathToken(&opStack);
-        freeStackMathToken(&unaryStack1);
-        return err;
+    outPrintf("\n###### PROGRAM %d ######\n", n);
+
+    inputSetOrigin(in);
+    err = parse(prog, in);
+    if (err == SUCCESS && prog->symbols.count > ctx->varCount) {
+        error("Too many variables in program");
+        err = MALLOC_ERROR;
     }
-    err = stackInitExpression(&exprStack, EXPRESSION_STACK_START_CAP);
-    if (err != SUCCESS) {
-        error("Memory allocation error");
-        freeStackMathToken(&opStack);
-        freeStackMathToken(&unaryStack1);
-        freeStackMathToken(&unaryStack2);
-        return err;
+    for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+        err = prepareStatement(p, prog, &prog->statements[i]);
     }
 
-    for (; !is(TK_END) && !is(TK_RPAREN) && !is(TK_COMMA); ) {
-        Expression* expr;
-        MathToken t1, t2;
-
-        err = parseUnaryExpression(tk, &expr, st, &st, &unaryStack1, &unaryStack2);
-        if (err != SUCCESS) {
-            parserError("Cannot parse unary expression");
-            EXIT_ERROR;
+    if (err == ERROR) {
+        printParsingError(in, prog);
+        inputSkipProgram(in);
+    }
+    else if (err == SUCCESS) {
+        outPrintf("\n======= OUT =======\n\n");
+        for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+            err = executeStatement(ctx, in, &prog->statements[i]);
         }
-        err = stackPushExpression(&exprStack, &expr);
-        if (err != SUCCESS) {
-            parserError("Cannot push to stack");
-            EXIT_ERROR;
+        if (err == SUCCESS) {
+            outPrintf("\n===== SUCCESS =====\n");
         }
+    }
 
-        if (is(TK_END) || is(TK_RPAREN) || is(TK_COMMA) || is(TK_RPAREN_SQ) || is(TK_RBR)) break;
-        
-        t1.op = tokenToBinaryOrAssignmentOperator(tk);
-        if (t1.op == -1) {
-            parserError("Bad binary operator `%s`", tk->id);
-            EXIT_ERROR;
-        }
-        t1.pr = getOpPriority(t1.op);
-        next();
+    ctxReset(ctx);
+    resetPreparer(p);
+    resetProgram(prog);
+    return err == MALLOC_ERROR ? MALLOC_ERROR : SUCCESS;
+}
 
+// programs are run one by one
+// Ret: SUCCESS, MALLOC_ERROR
+int runBatch(Program* prog, InputBuffer* in, Context* ctx) {
+    Preparer p;
+    int err = SUCCESS;
 
-        while (opStack.size != 0) {
-            stackTopMathToken(&opStack, &t2);
+    if (initPreparer(&p, prog) != SUCCESS) {
+        freePreparer(&p);
+        return MALLOC_ERROR;
+    }
 
-            if (
-                (t1.pr.isLeftAssoc && t1.pr.priority >= t2.pr.priority) ||
-                (!t1.pr.isLeftAssoc && t1.pr.priority > t2.pr.priority)
-            ) {
-                ExpressionType te;
-                Expression* expr;
+    for (int n = 1; err == SUCCESS && !inputIsOver(in); n++) {
+        err = runBatchProgram(prog, in, ctx, &p, n);
+    }
 
-                if (isBinary(t2.op)) {
-                    expr = allocExpression(EXPR_BINARY);
-                    if (expr == NULL) {
-                        error("Memory allocation error");
-                        EXIT_ERROR;
-                    }
-                    if ((err = stackPopExpression(&exprStack, &expr->be.expr2)) != SUCCESS) {
-                        parserError("No expression to pop");
-                        free(expr);
-                        EXIT_ERROR;
-                    }
-                    if ((err = stackPopExpression(&exprStack, &expr->be.expr1)) != SUCCESS) {
-                        parserError("No expression to pop");
-                        freeExpression(expr->be.expr2);
-                        free(expr);
-                        EXIT_ERROR;
-                    }
-                    expr->be.op = (BinaryOperatorType) t2.op;
-                }
-                else if (isAssignment(t2.op)) {
-                    expr = allocExpression(EXPR_ASSIGNMENT);
-                    if (expr == NULL) {
-                        error("Memory allocation error");
-                        EXIT_ERROR;
-                    }
-                    if ((err = stackPopExpression(&exprStack, &expr->ae.expr2)) != SUCCESS) {
-                        parserError("No expression to pop");
-                        free(expr);
-                        EXIT_ERROR;
-                    }
-                    if ((err = stackPopExpression(&exprStack, &expr->ae.expr1)) != SUCCESS) {
-                        parserError("No expression to pop");
-                        freeExpression(expr->be.expr2);
-                        free(expr);
-                        EXIT_ERROR;
-                    }
-                    expr->ae.op = (AssignmentOperatorType) t2.op;
-                }
-                else {
-                    error("Bad token type %d", t2.op);
-                    EXIT_ERROR;
-                }
+    if (in->error != SUCCESS) err = in->error;
+    freePreparer(&p);
+    return err == MALLOC_ERROR ? MALLOC_ERROR : SUCCESS;
+}
 
-                stackPopMathToken(&opStack, NULL);
-                
-                if ((err = stackPushExpression(&exprStack, &expr)) != SUCCESS) {
-                    error("Memory allocation error");
-                    freeExpression(expr);
-                    EXIT_ERROR;
-                }
-            }
-            else break;
-        }
-        stackPushMathToken(&opStack, &t1);
-    }
+// sets of initial values for runs of one prepared program, bindings of run i are
+// bindings[runFirst[i]] .. bindings[runFirst[i + 1] - 1]
+typedef struct {
+    int slot;
+    ValueExpression v;
+} ParamBinding;
 
-    while (stackPopMathToken(&opStack, &mt) == SUCCESS) {
-        Expression* newExpr = allocExpression(isBinary(mt.op) ? EXPR_BINARY : EXPR_ASSIGNMENT);
-        if (newExpr == NULL) {
-            error("Memory allocation error");
-            return MALLOC_ERROR;
-        }
+typedef struct {
+    ParamBinding* bindings;
+    int bindingCount;
+    int bindingCapacity;
+    int* runFirst; // runCount + 1 items
+    int runCount;
+    int runCapacity;
+    int isLaned; // runs are executed by groups of VM_LANES at once
+} ParamSets;
+
+void freeParamSets(ParamSets* sets) {
+    free(sets->bindings);
+    free(sets->runFirst);
+    sets->bindings = NULL;
+    sets->runFirst = NULL;
+    sets->bindingCount = sets->bindingCapacity = sets->runCount = sets->runCapacity = 0;
+}
 
-        if (isBinary(mt.op)) {
-            if ((err = stackPopExpression(&exprStack, &newExpr->be.expr2)) != SUCCESS) {
-                parserError("No expression to pop");
-                free(newExpr);
-                EXIT_ERROR;
-            }
-            if ((err = stackPopExpression(&exprStack, &newExpr->be.expr1)) != SUCCESS) {
-                parserError("No expression to pop");
-                freeExpression(newExpr->be.expr2);
-                free(newExpr);
-                EXIT_ERROR;
-            }
-            newExpr->be.op = (BinaryOperatorType) mt.op;
-        }
-        else {
-            if ((err = stackPopExpression(&exprStack, &newExpr->ae.expr2)) != SUCCESS) {
-                parserError("No expression to pop");
-                free(newExpr);
-                EXIT_ERROR;
-            }
-            if ((err = stackPopExpression(&exprStack, &newExpr->ae.expr1)) != SUCCESS) {
-                parserError("No expression to pop");
-                freeExpression(newExpr->be.expr2);
-                free(newExpr);
-                EXIT_ERROR;
-            }
-            newExpr->ae.op = (AssignmentOperatorType) mt.op;
-        }
-        
-        if ((err = stackPushExpression(&exprStack, &newExpr)) != SUCCESS) {
-            error("Memory allocation error");
-            EXIT_ERROR;
-        }
+// Ret: SUCCESS, MALLOC_ERROR
+int addParamBinding(ParamSets* sets, int slot, ValueExpression v) {
+    if (sets->bindingCount == sets->bindingCapacity) {
+        int newCapacity = sets->bindingCapacity ? sets->bindingCapacity * ARRAY_GROW_FACTOR : PARAMS_START_CAP;
+        ParamBinding* newBindings = (ParamBinding*) realloc(sets->bindings, newCapacity * sizeof(ParamBinding));
+
+        if (newBindings == NULL) return MALLOC_ERROR;
+        sets->bindings = newBindings;
+        sets->bindingCapacity = newCapacity;
     }
 
-    if ((err = stackPopExpression(&exprStack, toE)) != SUCCESS) {
-        parserError("No expression to pop");
-        EXIT_ERROR;
+    sets->bindings[sets->bindingCount].slot = slot;
+    sets->bindings[sets->bindingCount].v = v;
+    sets->bindingCount++;
+    return SUCCESS;
+}
+
+// bindings added since the previous run become the next run
+// Ret: SUCCESS, MALLOC_ERROR
+int addParamRun(ParamSets* sets) {
+    if (sets->runCount + 1 >= sets->runCapacity) {
+        int newCapacity = sets->runCapacity ? sets->runCapacity * ARRAY_GROW_FACTOR : PARAMS_START_CAP;
+        int* newFirst = (int*) realloc(sets->runFirst, newCapacity * sizeof(int));
+
+        if (newFirst == NULL) return MALLOC_ERROR;
+        sets->runFirst = newFirst;
+        sets->runCapacity = newCapacity;
+        if (sets->runCount == 0) sets->runFirst[0] = 0;
     }
 
-    *toS = st;
-    freeStackExpression(&exprStack);
-    freeStackMathToken(&opStack);
-    freeStackMathToken(&unaryStack1);
-    freeStackMathToken(&unaryStack2);
+    sets->runFirst[++sets->runCount] = sets->bindingCount;
     return SUCCESS;
+}
 
-    #undef EXIT_ERROR
+// token of the line, spaces and commas between tokens are skipped, `//` comments the rest of it
+// Ret: NULL - line is over, next s - success
+char* parseParamToken(Token* tk, char* s, char* end) {
+    while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == ',')) s++;
+    if (s >= end || (s[0] == '/' && s[1] == '/')) return NULL;
+
+    s = parseToken(tk, s);
+    if (s == NULL || s > end) {
+        tk->type = TK_UNKNOWN;
+        tk->len = end - tk->text;
+        return end;
+    }
+    return s;
 }
 
+// every non-empty line of the file is one run: `name = number` pairs separated by spaces or
+// commas, number may have minus, `//` comments the rest of the line. Only scalar variables
+// declared by the program can be bound
 // Ret: SUCCESS, ERROR, MALLOC_ERROR
-int parseExpression(Token* tk, Expression** toE, char* st, char** toS) {
-    Expression* expr;
-    Expression* commaExpr;
-    ExpressionList* exprList;
-    ExpressionList* last;
+int parseParams(ParamSets* sets, const Program* prog, const char* path) {
+    FILE* f = fopen(path, "rb");
+    InputBuffer pin;
+    char* bindable;
+    char* s;
+    uint line = 1;
     int err;
 
-    if ((err = parseExpressionWithoutComma(tk, &expr, st, &st)) != SUCCESS) return err;
-
-    if (!is(TK_COMMA)) {
-        *toE = expr;
-        *toS = st;
-        return SUCCESS;
+    memset(sets, 0, sizeof(ParamSets));
+    if (f == NULL) {
+        error("Cannot open parameters `%s`", path);
+        return ERROR;
     }
 
-    commaExpr = (Expression*) malloc(sizeof(*commaExpr));
-    if (commaExpr == NULL) {
-        error("Cannot allocate memory");
-        freeExpression(expr);
-        return MALLOC_ERROR;
+    bindable = (char*) calloc(prog->symbols.count ? prog->symbols.count : 1, 1);
+    err = bindable == NULL ? MALLOC_ERROR : inputOpen(&pin, f, 0);
+    fclose(f);
+    if (err != SUCCESS) {
+        if (err == ERROR) error("Cannot read parameters `%s`", path);
+        free(bindable);
+        return err;
     }
-    commaExpr->type = EXPR_COMMA;
 
-    exprList = (ExpressionList*) malloc(sizeof(*exprList));
-    if (exprList == NULL) {
-        error("Cannot allocate memory");
-        freeExpression(expr);
-        free(commaExpr);
-        return MALLOC_ERROR;
+    for (int i = 0; i < prog->statementCount; i++) {
+        const Statement* st = &prog->statements[i];
+
+        if (st->type != ST_VARIABLE_DECLARATION) continue;
+        for (int j = 0; j < st->vs.vAmount; j++) {
+            const VarDeclField* field = &st->vs.variables[j];
+            bindable[field->slot] = !field->isArray && field->pLevel == 0;
+        }
     }
-    exprList->expr = expr;
-    exprList->next = NULL;
-    last = exprList;
 
-    commaExpr->cme.exprs = exprList;
+    for (s = pin.data; err == SUCCESS && s < pin.data + pin.size; line++) {
+        char* end = memchr(s, '\n', pin.data + pin.size - s);
+        int first = sets->bindingCount;
+        Token tk;
 
-    while (match(TK_COMMA)) {
-        ExpressionList* newNode;
+        if (end == NULL) end = pin.data + pin.size;
 
-        err = parseExpressionWithoutComma(tk, &expr, st, &st);
-        if (err != SUCCESS) {
-            freeExpression(commaExpr); // list must be freed automatically
-            return err;
+        while (err == SUCCESS && (s = parseParamToken(&tk, s, end)) != NULL) {
+            const Token name = tk;
+            int slot = -1, isNegative = 0;
+
+            if (name.type == TK_ID) slot = symbolLookup(&prog->symbols, name.text, name.len);
+            if (slot == -1 || !bindable[slot]) {
+                error("Parameter `%.*s` in the line %u is not a scalar variable of the program",
+                      (int) name.len, name.text, line);
+                err = ERROR;
+                break;
+            }
+
+            if ((s = parseParamToken(&tk, s, end)) == NULL || tk.type != TK_EQ ||
+                (s = parseParamToken(&tk, s, end)) == NULL ||
+                (tk.type == TK_MINUS && (isNegative = 1, s = parseParamToken(&tk, s, end)) == NULL) ||
+                (tk.type != TK_INT_CONSTANT && tk.type != TK_FLOAT_CONSTANT)) {
+                error("Parameter `%.*s` in the line %u has no number value", (int) name.len, name.text, line);
+                err = ERROR;
+                break;
+            }
+
+            if (isNegative && tk.type == TK_INT_CONSTANT) tk.iVal = (longlong) (0ULL - (ulonglong) tk.iVal);
+            if (isNegative && tk.type == TK_FLOAT_CONSTANT) tk.fVal = -tk.fVal;
+            err = addParamBinding(sets, slot, tokenValue(&tk));
         }
 
-        newNode = (ExpressionList*) malloc(sizeof(*newNode));
-        if (newNode == NULL) {
-            error("Cannot allocate memory");
-            freeExpression(commaExpr);
-            return MALLOC_ERROR;
+        // empty line is not a run
+        if (err == SUCCESS && sets->bindingCount > first) err = addParamRun(sets);
+        s = end + 1;
+    }
+
+    if (err == SUCCESS && sets->runCount == 0) {
+        error("No parameter sets in `%s`", path);
+        err = ERROR;
+    }
+    if (err == MALLOC_ERROR) error("Memory allocation error");
+    if (err != SUCCESS) freeParamSets(sets);
+    inputClose(&pin);
+    free(bindable);
+    return err;
+}
+
+// statements of prepared program are run in context which is ready for it
+// Ret: SUCCESS, ERROR - evaluation error, MALLOC_ERROR
+int executeProgram(Context* ctx, const Program* prog, const InputBuffer* in) {
+    int err = SUCCESS;
+
+    outPrintf("\n======= OUT =======\n\n");
+    for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+        err = executeStatement(ctx, in, &prog->statements[i]);
+    }
+    if (err == SUCCESS) {
+        outPrintf("\n===== SUCCESS =====\n");
+    }
+    return err;
+}
+
+// program runs by lanes when all its statements are compiled to lane code and its variables are
+// scalars which are declared once. Initializers of bound variables are run by all lanes, though
+// scalar run skips them, so their code must be pure
+// Ret: SUCCESS, MALLOC_ERROR
+int checkLaneProgram(const Program* prog, const ParamSets* sets, int* isLaned) {
+    char* declared = (char*) calloc(prog->symbols.count ? prog->symbols.count : 1, 2);
+    char* bound = declared + (prog->symbols.count ? prog->symbols.count : 1);
+
+    if (declared == NULL) return MALLOC_ERROR;
+    for (int i = 0; i < sets->bindingCount; i++) bound[sets->bindings[i].slot] = 1;
+    *isLaned = 1;
+
+    for (int i = 0; i < prog->statementCount && *isLaned; i++) {
+        const Statement* st = &prog->statements[i];
+        const Expression* root = NULL;
+
+        switch (st->type) {
+            case ST_VARIABLE_DECLARATION:
+                if (st->vs.vType == PT_VOID) *isLaned = 0;
+                for (int j = 0; j < st->vs.vAmount && *isLaned; j++) {
+                    const VarDeclField* f = &st->vs.variables[j];
+
+                    root = f->expr != 0 ? exprAt(&prog->exprs, f->expr) : NULL;
+                    if (f->isArray || f->pLevel != 0 || declared[f->slot] ||
+                        (root != NULL && (root->type != EXPR_COMPILED || !vmIsLaneCode(root->cpe.code, bound[f->slot])))) {
+                        *isLaned = 0;
+                    }
+                    declared[f->slot] = 1;
+                }
+                break;
+            case ST_EXPRESSION:
+            case ST_PRINT:
+                root = exprAt(&prog->exprs, st->type == ST_EXPRESSION ? st->es.expr : st->ps.expr);
+                if (root->type != EXPR_COMPILED || !vmIsLaneCode(root->cpe.code, 0)) *isLaned = 0;
+                break;
+            default:
+                *isLaned = 0;
         }
-        newNode->expr = expr;
-        newNode->next = NULL;
-        last->next = newNode;
-        last = newNode;
     }
 
-    *toE = commaExpr;
-    *toS = st;
+    free(declared);
     return SUCCESS;
 }
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-// adds new statement to ->next
-int parseVarDeclarationStatement(Token* tk, StatementList* last, char* st) {
-    StatementList* node;
-    PrimitiveType pt;
-    int* vAmount, isUnsigned = 0;
+// context runs the program once per parameter set, its params and lanes are allocated with it
+// Ret: MALLOC_ERROR, SUCCESS
+int ctxInitParams(Context* ctx, const Program* prog, int isSandboxed, int isLaned) {
+    int err = ctxInit(ctx, prog, prog->symbols.count, isSandboxed);
+    size_t slotCount = prog->symbols.count ? prog->symbols.count : 1;
 
-    st = parseDeclarationType(tk, &pt, st);
-    if (st == NULL) {
-        parserError("Cannot parse type of variable declaration");
-        return ERROR;
-    }
+    if (err != SUCCESS) return err;
+    ctx->params = (ValueExpression*) calloc(slotCount, sizeof(ValueExpression));
+    if (ctx->params == NULL) return MALLOC_ERROR;
+    if (!isLaned) return SUCCESS;
+
+    // values and parameters of lanes follow the registers in one block
+    ctx->lanes = (ParamLanes*) calloc(1, sizeof(ParamLanes) + slotCount * VM_LANES * (sizeof(VmReg) + sizeof(ValueExpression)));
+    if (ctx->lanes == NULL) return MALLOC_ERROR;
+    ctx->lanes->vars = (VmReg*) (ctx->lanes + 1);
+    ctx->lanes->params = (ValueExpression*) (ctx->lanes->vars + slotCount * VM_LANES);
+    return SUCCESS;
+}
 
-    node = allocStatementList();
+// run is printed as separate program n, variables and memory are reset after it
+// Ret: SUCCESS, MALLOC_ERROR
+int runParamSet(Context* ctx, const Program* prog, const InputBuffer* in, const ParamSets* sets, int run) {
+    int err;
 
-    if (node == NULL) return MALLOC_ERROR;
-    vAmount = &node->st.vs.vAmount;
+    outPrintf("\n###### RUN %d ######\n", run + 1);
 
-    node->st.type = ST_VARIABLE_DECLARATION;
-    node->st.vs.vType = pt;
+    for (int i = sets->runFirst[run]; i < sets->runFirst[run + 1]; i++) {
+        ctx->params[sets->bindings[i].slot] = sets->bindings[i].v;
+    }
+    err = executeProgram(ctx, prog, in);
+    for (int i = sets->runFirst[run]; i < sets->runFirst[run + 1]; i++) {
+        ctx->params[sets->bindings[i].slot].type.pt = PT_VOID;
+    }
 
-    for (; *vAmount < MAX_VARS_PER_STATEMENT;) {
-        VarDeclField* fld = &node->st.vs.variables[*vAmount];
-        
-        while (match(TK_STAR)) fld->pLevel++;
+    ctxReset(ctx);
+    return err == MALLOC_ERROR ? MALLOC_ERROR : SUCCESS;
+}
 
-        if (!is(TK_ID)) {
-            errExp(TK_ID);
-            freeStatementList(node);
-            node = NULL;
+// parameters of runs first .. first + count - 1 are set to lanes or cleared, lanes past count
+// repeat the first run
+void setLaneParams(ParamLanes* lanes, const ParamSets* sets, int first, int count, int isSet) {
+    for (int l = 0; l < VM_LANES; l++) {
+        int run = first + (l < count ? l : 0);
 
-            return ERROR;
-        }
+        for (int i = sets->runFirst[run]; i < sets->runFirst[run + 1]; i++) {
+            ValueExpression* p = &lanes->params[(size_t) sets->bindings[i].slot * VM_LANES + l];
 
-        strcpy(fld->name, tk->id);
-        next();
-        
-        if (match(TK_LPAREN_SQ)) {
-            fld->isArray = 1;
-            if (match(TK_RPAREN_SQ));
-            else if (is(TK_INT_CONSTANT)) {
-                fld->arraySize = tk->iVal;
-                next();
-                if (!match(TK_RPAREN_SQ)) {
-                    errExp(TK_RPAREN_SQ);
-                    freeStatementList(node);
-                    return ERROR;
-                }
-            }
-            else {
-                parserError("Cannot parse [] after variable name");
-                freeStatementList(node);
-                return ERROR;
-            }
+            if (isSet) *p = sets->bindings[i].v;
+            else p->type.pt = PT_VOID;
         }
+    }
+}
 
-        if (match(TK_EQ)) {
-            if (!fld->isArray) {
-                int err = parseExpressionWithoutComma(tk, &fld->expr, st, &st);
-                if (err != SUCCESS) {
-                    parserError("Cannot parse expression in variable declaration");
-                    freeStatementList(node);
-                    return err;
-                }
-            }
-            else {
-                ExpressionList list;
-                ExpressionList* last = &list;
-                int err;
+// output of one lane, it is written when all lanes of the group end
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} LaneOutput;
+
+// Ret: SUCCESS, MALLOC_ERROR
+int laneWrite(LaneOutput* o, const char* s, size_t n) {
+    if (o->len + n > o->cap) {
+        size_t newCap = max(o->cap * 2, o->len + n + 4096);
+        char* newData = (char*) realloc(o->data, newCap);
+
+        if (newData == NULL) return MALLOC_ERROR;
+        o->data = newData;
+        o->cap = newCap;
+    }
+    memcpy(o->data + o->len, s, n);
+    o->len += n;
+    return SUCCESS;
+}
 
-                list.next = NULL;
-                fld->arrDataPtr = NULL;
+// printValueExpression writes to a stream, its text is moved to the lane
+// Ret: SUCCESS, MALLOC_ERROR
+int lanePrintValue(LaneOutput* o, ValueExpression* ve) {
+    FILE* savedStream = outStream;
+    char* text = NULL;
+    size_t len = 0;
+    int err;
 
-                if (!match(TK_LBR)) {
-                    errExp(TK_LBR);
-                    freeStatementList(node);
-                    return ERROR;
-                }
+    outStream = open_memstream(&text, &len);
+    if (outStream == NULL) {
+        outStream = savedStream;
+        return MALLOC_ERROR;
+    }
+    printValueExpression(ve);
+    fclose(outStream);
+    outStream = savedStream;
 
-                for (;;) {
-                    ExpressionList* newNode;
+    err = laneWrite(o, text, len);
+    free(text);
+    return err;
+}
 
-                    if (is(TK_RBR)) break;
+// runs first .. first + count - 1, count <= VM_LANES, are executed at once by lane code. Output of
+// every run is collected apart and written in order, it is the same as for runParamSet
+// Ret: SUCCESS, MALLOC_ERROR
+int runParamLanes(Context* ctx, const Program* prog, const InputBuffer* in, const ParamSets* sets, int first, int count) {
+    ParamLanes* lanes = ctx->lanes;
+    LaneOutput outs[VM_LANES];
+    char header[64];
+    int err = SUCCESS;
+
+    memset(outs, 0, sizeof(outs));
+    setLaneParams(lanes, sets, first, count, 1);
+    for (int l = 0; l < count && err == SUCCESS; l++) {
+        int n = snprintf(header, sizeof(header), "\n###### RUN %d ######\n\n======= OUT =======\n\n", first + l + 1);
+        err = laneWrite(&outs[l], header, n);
+    }
 
-                    newNode = (ExpressionList*) malloc(sizeof(*newNode));
-                    if (newNode == NULL) {
-                        error("Memory allocation error");
-                        freeStatementList(node);
-                        freeExpressionList(list.next);
-                        return MALLOC_ERROR;
-                    }
-                    newNode->next = NULL;
-                    
-                    err = parseExpressionWithoutComma(tk, &newNode->expr, st, &st);
-                    if (err != SUCCESS) {
-                        freeStatementList(node);
-                        freeExpressionList(list.next);
-                        return err;
+    for (int i = 0; i < prog->statementCount && err == SUCCESS; i++) {
+        Statement* st = &prog->statements[i];
+        uchar changes[VM_LANES] = {0};
+
+        switch (st->type) {
+            case ST_VARIABLE_DECLARATION:
+                for (int j = 0; j < st->vs.vAmount; j++) {
+                    const VarDeclField* f = &st->vs.variables[j];
+                    const Expression* root = f->expr != 0 ? exprAt(&prog->exprs, f->expr) : NULL;
+                    Type declType = {st->vs.vType, 0};
+                    int width = valueWidth(declType);
+
+                    if (root != NULL) vmRunLanes(lanes, root->cpe.code, changes);
+                    for (int l = 0; l < VM_LANES; l++) {
+                        const ValueExpression* p = &lanes->params[(size_t) f->slot * VM_LANES + l];
+                        ValueExpression ve;
+
+                        initValueExpression(&ve);
+                        ve.type = declType;
+                        if (p->type.pt != PT_VOID) {
+                            ve = *p;
+                        }
+                        else if (root != NULL) {
+                            ve.type = root->cpe.code->type;
+                            ve.ull = lanes->results[l].ull;
+                        }
+                        if (declType.pt != ve.type.pt || declType.pLevel != ve.type.pLevel) ve = castTo(declType, &ve);
+                        memcpy(&lanes->vars[(size_t) f->slot * VM_LANES + l], &ve.ull, width);
                     }
-
-                    last->next = newNode;
-                    last = newNode;
-
-                    if (!match(TK_COMMA)) break;
                 }
+                memset(changes, 1, sizeof(changes));
+                break;
+            case ST_EXPRESSION:
+                vmRunLanes(lanes, exprAt(&prog->exprs, st->es.expr)->cpe.code, changes);
+                break;
+            case ST_PRINT: {
+                const VmCode* code = exprAt(&prog->exprs, st->ps.expr)->cpe.code;
 
-                fld->exprList = list.next;
+                vmRunLanes(lanes, code, changes);
+                for (int l = 0; l < count && err == SUCCESS; l++) {
+                    ValueExpression ve;
 
-                if (!match(TK_RBR)) {
-                    errExp(TK_RBR);
-                    freeStatementList(node);
-                    freeExpressionList(list.next);
-                    return ERROR;
+                    ve.type = code->type;
+                    ve.ull = lanes->results[l].ull;
+                    err = lanePrintValue(&outs[l], &ve);
                 }
+                break;
             }
+            default:
+                break;
         }
-        if (match(TK_COMMA)) {
-            (*vAmount)++;
-            continue;
-        }
-        if (is(TK_END)) {
-            break;
+
+        for (int l = 0; l < count && err == SUCCESS; l++) {
+            if (!changes[l]) continue;
+            err = laneWrite(&outs[l], inputAt(in, st->codeOffset), st->codeLen);
+            if (err == SUCCESS) err = laneWrite(&outs[l], ";\n", 2);
         }
     }
+    setLaneParams(lanes, sets, first, count, 0);
 
-    (*vAmount)++;
-    last->next = node;
-    return SUCCESS;
+    for (int l = 0; l < count; l++) {
+        if (err == SUCCESS) err = laneWrite(&outs[l], "\n===== SUCCESS =====\n", 21);
+        if (err == SUCCESS) fwrite(outs[l].data, 1, outs[l].len, OUT_STREAM);
+        free(outs[l].data);
+    }
+    return err;
 }
 
-int parseExpressionStatement(Token* tk, StatementList* last, char* st) {
-    StatementList* node;
-    Expression* expr;
-    int err = parseExpression(tk, &expr, st, &st);
-
-    if (err != SUCCESS) return err;
+// Ret: amount of groups of runs, a group is executed by lanes or it is a single run
+int paramGroupCount(const ParamSets* sets) {
+    return sets->isLaned ? (sets->runCount + VM_LANES - 1) / VM_LANES : sets->runCount;
+}
 
-    node = allocStatementList();
-    if (node == NULL) {
-        freeExpression(expr);
-        expr = NULL;
-        return MALLOC_ERROR;
-    }
+// Ret: SUCCESS, MALLOC_ERROR
+int runParamGroup(Context* ctx, const Program* prog, const InputBuffer* in, const ParamSets* sets, int group) {
+    if (!sets->isLaned) return runParamSet(ctx, prog, in, sets, group);
+    return runParamLanes(ctx, prog, in, sets, group * VM_LANES, min(VM_LANES, sets->runCount - group * VM_LANES));
+}
 
-    node->st.type = ST_EXPRESSION;
-    node->st.es.expr = expr;
+typedef struct {
+    char* begin; // program in input, up to its empty statement
+    size_t len;
+
+    // output of finished program
+    char* out;
+    size_t outLen;
+    char* err;
+    size_t errLen;
+    int status; // SUCCESS, MALLOC_ERROR
+    int isDone;
+} BatchJob;
+
+// workers take jobs by chunks in input order; finished jobs wait in their slots until
+// all previous ones are written, so output is the same as for runBatch.
+// Workers don't run ahead of written output more than BATCH_WINDOW jobs
+typedef struct {
+    BatchJob* jobs;
+    int jobCount;
+    int nextJob;
+    int writtenCount;
+    int workerCount; // running workers, main doesn't wait for jobs when all of them failed
+    int isStopped;
+    int isSandboxed; // contexts of workers
+    // jobs are runs of prepared prog over sets, its statements are in source; NULL - jobs are programs
+    const Program* prog;
+    const InputBuffer* source;
+    const ParamSets* sets;
+
+    pthread_mutex_t lock;
+    pthread_cond_t jobDone;
+    pthread_cond_t jobWritten;
+} BatchQueue;
+
+// input is split at empty statements, like inputSkipProgram does it for runBatch
+// Ret: SUCCESS, MALLOC_ERROR
+int splitBatch(BatchQueue* q, InputBuffer* in) {
+    int cap = 0;
+
+    q->jobs = NULL;
+    q->jobCount = 0;
+
+    while (!inputIsOver(in)) {
+        BatchJob* job;
+
+        if (q->jobCount == cap) {
+            int newCap = cap ? cap * ARRAY_GROW_FACTOR : BATCH_START_CAP;
+            BatchJob* newJobs = (BatchJob*) realloc(q->jobs, newCap * sizeof(BatchJob));
+
+            if (newJobs == NULL) return MALLOC_ERROR;
+            q->jobs = newJobs;
+            cap = newCap;
+        }
 
-    last->next = node;
+        job = &q->jobs[q->jobCount++];
+        memset(job, 0, sizeof(BatchJob));
+        job->begin = in->data + in->pos;
+        inputSkipProgram(in);
+        job->len = in->data + in->pos - job->begin;
+    }
     return SUCCESS;
 }
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-// print ^ expr...;
-int parsePrintStatement(Token* tk, StatementList* last, char* st) {
-    StatementList* newL = allocStatementList();
-    if (newL == NULL) {
-        error("Memory allocation error");
+// output of the job is collected in memory streams which become its buffers
+// Ret: SUCCESS, MALLOC_ERROR
+int runBatchJob(BatchQueue* q, BatchJob* job, Program* prog, Context* ctx, Preparer* p, int n) {
+    InputBuffer in;
+    int err;
+
+    outStream = open_memstream(&job->out, &job->outLen);
+    errStream = open_memstream(&job->err, &job->errLen);
+    if (outStream == NULL || errStream == NULL) {
+        if (outStream != NULL) fclose(outStream), free(job->out);
+        if (errStream != NULL) fclose(errStream), free(job->err);
+        outStream = errStream = NULL;
+        job->out = job->err = NULL;
+        job->outLen = job->errLen = 0;
         return MALLOC_ERROR;
     }
-    newL->st.type = ST_PRINT;
-    if (parseExpression(tk, &newL->st.ps.expr, st, &st) != SUCCESS) {
-        parserError("Cannot parse expression after print");
-        free(newL);
-        return ERROR;
+
+    if (q->sets != NULL) {
+        err = runParamGroup(ctx, q->prog, q->source, q->sets, n - 1);
+    }
+    else {
+        memset(&in, 0, sizeof(InputBuffer));
+        in.data = job->begin;
+        in.size = job->len;
+        err = runBatchProgram(prog, &in, ctx, p, n);
     }
-    last->next = newL;
-    return SUCCESS;
-}
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-// adds new statement to ->next
-int parseStatement(StatementList* last, char* st) {
-    Token token;
-    Token* tk = &token;
+    // buffers are updated by fclose
+    fclose(outStream);
+    fclose(errStream);
+    outStream = errStream = NULL;
+    return err;
+}
 
-    next();
+void* batchWorker(void* arg) {
+    BatchQueue* q = (BatchQueue*) arg;
+    Program prog;
+    Context ctx;
+    Preparer p;
+    int err;
 
-    if (isTypeBeginning(tk)) {
-        return parseVarDeclarationStatement(tk, last, st);
+    // runs of parameter sets share prepared program, only context is own
+    initProgram(&prog);
+    if (q->sets != NULL) {
+        err = ctxInitParams(&ctx, q->prog, q->isSandboxed, q->sets->isLaned);
     }
-    else if (match(TK_PRINT)) {
-        return parsePrintStatement(tk, last, st);
+    else {
+        err = ctxInit(&ctx, &prog, STREAM_MAX_VARS, q->isSandboxed);
+        if (err == SUCCESS) {
+            err = initPreparer(&p, &prog);
+            if (err != SUCCESS) freePreparer(&p);
+        }
     }
 
-    return parseExpressionStatement(tk, last, st);
-}
+    pthread_mutex_lock(&q->lock);
+    while (err == SUCCESS) {
+        int first, last;
 
-#undef is
-#undef match
-#undef next
-#undef parserError
-#undef errExp
+        while (!q->isStopped && q->nextJob < q->jobCount && q->nextJob >= q->writtenCount + BATCH_WINDOW) {
+            pthread_cond_wait(&q->jobWritten, &q->lock);
+        }
+        if (q->isStopped || q->nextJob >= q->jobCount) break;
 
-// Ret: SUCCESS, ERROR, MALLOC_ERROR
-int parse(StatementList** listOut, FILE* from) {
-    StatementList base;
-    StatementList* last = &base;
-    base.next = NULL;
+        first = q->nextJob;
+        last = min(first + BATCH_CHUNK, q->jobCount);
+        q->nextJob = last;
+        pthread_mutex_unlock(&q->lock);
 
-    for (;;) {
-        char statement[PARSER_LINE_BUFFER], *s;
-        int err;
+        for (int i = first; i < last; i++) {
+            q->jobs[i].status = runBatchJob(q, &q->jobs[i], &prog, &ctx, &p, i + 1);
+        }
 
-        s = fgetsd(statement, PARSER_LINE_BUFFER, from, ';');
-        if (s == NULL) break;
-        s = strskp(s);
-        if (!*s) break;
+        pthread_mutex_lock(&q->lock);
+        for (int i = first; i < last; i++) q->jobs[i].isDone = 1;
+        pthread_cond_signal(&q->jobDone);
+    }
+    q->workerCount--;
+    pthread_cond_signal(&q->jobDone);
+    pthread_mutex_unlock(&q->lock);
 
-        err = parseStatement(last, s);
-        if (err != SUCCESS) {
-            freeStatementList(base.next);
-            base.next = NULL;
-            return err;
-        }
-        
-        if (last->next != NULL) {
-            char* copyWhat = strskp(statement);
-            size_t l = strlen(copyWhat);
-            char* codeLine = (char*) malloc((l + 1) * sizeof(*codeLine));
+    if (err == SUCCESS && q->sets == NULL) freePreparer(&p);
+    freeContext(&ctx);
+    freeProgram(&prog);
+    return NULL;
+}
 
-            if (codeLine == NULL) {
-                error("Memory allocation error");
-                freeStatementList(base.next);
-                return MALLOC_ERROR;
-            }
+// jobs of the queue are run by threadCount workers and written in order, queue is freed after it.
+// err - result of filling the queue, nothing is run on error
+// Ret: SUCCESS, MALLOC_ERROR
+int runBatchQueue(BatchQueue* q, int threadCount, int err) {
+    pthread_t* threads = (pthread_t*) malloc(threadCount * sizeof(pthread_t));
+    int createdCount;
+
+    q->nextJob = q->writtenCount = q->workerCount = q->isStopped = 0;
+    if (threads == NULL) err = MALLOC_ERROR;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->jobDone, NULL);
+    pthread_cond_init(&q->jobWritten, NULL);
+
+    // worker is counted before it starts, it may finish before the next one is created
+    for (createdCount = 0; createdCount < threadCount && err == SUCCESS; createdCount++) {
+        int isCreated;
+
+        pthread_mutex_lock(&q->lock);
+        q->workerCount++;
+        pthread_mutex_unlock(&q->lock);
+        isCreated = pthread_create(&threads[createdCount], NULL, batchWorker, q) == 0;
+        if (isCreated) continue;
+
+        pthread_mutex_lock(&q->lock);
+        q->workerCount--;
+        pthread_mutex_unlock(&q->lock);
+        break;
+    }
+    if (createdCount == 0) err = MALLOC_ERROR;
 
-            strcpy(codeLine, copyWhat);
+    for (int i = 0; i < q->jobCount && err == SUCCESS; i++) {
+        BatchJob* job = &q->jobs[i];
 
-            last = last->next;
-            last->st.codeLine = codeLine;
+        pthread_mutex_lock(&q->lock);
+        while (!job->isDone && q->workerCount > 0) pthread_cond_wait(&q->jobDone, &q->lock);
+        pthread_mutex_unlock(&q->lock);
+
+        if (!job->isDone) {
+            err = MALLOC_ERROR;
+            break;
         }
+
+        fwrite(job->out, 1, job->outLen, stdout);
+        fwrite(job->err, 1, job->errLen, stderr);
+        free(job->out);
+        free(job->err);
+        job->out = job->err = NULL;
+        err = job->status;
+
+        pthread_mutex_lock(&q->lock);
+        q->writtenCount = i + 1;
+        if (err != SUCCESS) q->isStopped = 1;
+        pthread_cond_broadcast(&q->jobWritten);
+        pthread_mutex_unlock(&q->lock);
     }
 
-    *listOut = base.next;
-    return SUCCESS;
+    pthread_mutex_lock(&q->lock);
+    q->isStopped = 1;
+    pthread_cond_broadcast(&q->jobWritten);
+    pthread_mutex_unlock(&q->lock);
+    for (int i = 0; i < createdCount; i++) pthread_join(threads[i], NULL);
+
+    // jobs done after stop are not written
+    for (int i = 0; i < q->jobCount; i++) {
+        free(q->jobs[i].out);
+        free(q->jobs[i].err);
+    }
+    pthread_cond_destroy(&q->jobWritten);
+    pthread_cond_destroy(&q->jobDone);
+    pthread_mutex_destroy(&q->lock);
+    free(q->jobs);
+    free(threads);
+    return err;
+}
+
+// programs are run by threadCount workers, each one has own program storage and context.
+// Whole input is read before the run
+// Ret: SUCCESS, MALLOC_ERROR
+int runBatchParallel(InputBuffer* in, int threadCount, int isSandboxed) {
+    BatchQueue q;
+
+    q.isSandboxed = isSandboxed;
+    q.prog = NULL;
+    q.source = NULL;
+    q.sets = NULL;
+    return runBatchQueue(&q, threadCount, splitBatch(&q, in));
+}
+
+// groups of runs of parameter sets are jobs, workers share the prepared program
+// Ret: SUCCESS, MALLOC_ERROR
+int runParamsParallel(const Program* prog, const InputBuffer* in, const ParamSets* sets, int threadCount, int isSandboxed) {
+    BatchQueue q;
+
+    q.isSandboxed = isSandboxed;
+    q.prog = prog;
+    q.source = in;
+    q.sets = sets;
+    q.jobCount = paramGroupCount(sets);
+    q.jobs = (BatchJob*) calloc(q.jobCount, sizeof(BatchJob));
+    return runBatchQueue(&q, threadCount, q.jobs == NULL ? MALLOC_ERROR : SUCCESS);
 }
 
-int main() {
+// parsed or loaded program is run, its statements are in input
+// Ret: exit status
+int runProgram(Program* prog, const InputBuffer* in, int isSandboxed) {
     Context ctx;
-    StatementList* l = NULL,* node;
-    int lineCounter;
+    int err = SUCCESS;
 
-    ctx.varList = NULL;
-    ctx.memRegList = NULL;
-    ctx.hasEvaluationError = 0;
+    if (ctxInit(&ctx, prog, prog->symbols.count, isSandboxed) != SUCCESS) {
+        outPrintf("\n====== ERROR ======\n");
+        outPrintf("Ends with malloc error\n");
+        freeContext(&ctx);
+        return 2;
+    }
 
-    printf("Enter linear C code:\n\n");
+    err = executeProgram(&ctx, prog, in);
+    freeContext(&ctx);
+    if (err == MALLOC_ERROR) {
+        outPrintf("Ends with malloc error\n");
+        return 2;
+    }
+    return 0;
+}
 
-    int err = parse(&l, stdin);
-    if (err == ERROR) {
-        printf("\n====== ERROR ======\n");
-        printf("Ends with parsing error\n");
-        freeCtxVarList(ctx.varList);
-        freeCtxMemRegList(ctx.memRegList);
-        freeStatementList(l);
+// prepared program is run once per parameter set of the file, by lanes when it can, by threadCount workers
+// Ret: exit status
+int runParams(const Program* prog, const InputBuffer* in, const char* path, int threadCount, int isSandboxed) {
+    ParamSets sets;
+    Context ctx;
+    int err = parseParams(&sets, prog, path);
+
+    if (err == SUCCESS) err = checkLaneProgram(prog, &sets, &sets.isLaned);
+    if (err == SUCCESS && threadCount > 1) {
+        err = runParamsParallel(prog, in, &sets, threadCount, isSandboxed);
+    }
+    else if (err == SUCCESS) {
+        err = ctxInitParams(&ctx, prog, isSandboxed, sets.isLaned);
+        for (int group = 0; group < paramGroupCount(&sets) && err == SUCCESS; group++) {
+            err = runParamGroup(&ctx, prog, in, &sets, group);
+        }
+        freeContext(&ctx);
+    }
+    freeParamSets(&sets);
+
+    if (err == SUCCESS) return 0;
+    outPrintf("\n====== ERROR ======\n");
+    outPrintf(err == ERROR ? "Ends with parameters error\n" : "Ends with malloc error\n");
+    return err == ERROR ? 1 : 2;
+}
+
+// Ret: number of threads, 0 - all cores, -1 - not a number
+int parseJobsArg(const char* s) {
+    char* end;
+    long n = strtol(s, &end, 10);
+
+    if (*s < '0' || *s > '9' || *end != 0 || n > INT_MAX) return -1;
+    return (int) n;
+}
+
+void printUsage(const char* name) {
+    fprintf(stderr, "Usage: %s [--sandbox] [MODE] < code.c\n", name);
+    fprintf(stderr, "MODE is one of:\n");
+    fprintf(stderr, "    --jobs N\n");
+    fprintf(stderr, "    --stream\n");
+    fprintf(stderr, "    --batch [--jobs N]\n");
+    fprintf(stderr, "    --save-image FILE\n");
+    fprintf(stderr, "    --load-image FILE\n");
+    fprintf(stderr, "    --params FILE [--jobs N]\n");
+    fprintf(stderr, "--sandbox goes before the mode, N = 0 - one thread per core\n");
+}
+
+int main(int argc, char** argv) {
+    Context ctx;
+    InputBuffer in;
+    Program prog;
+    int status = 0;
+    const char* name = argv[0];
+    // goes before the mode
+    int isSandboxed = argc > 1 && strcmp(argv[1], "--sandbox") == 0 ? (argc--, argv++, 1) : 0;
+    int isStream = argc > 1 && strcmp(argv[1], "--stream") == 0;
+    int isBatch = argc > 1 && strcmp(argv[1], "--batch") == 0;
+    int isJobs = argc > 2 && strcmp(argv[1], "--jobs") == 0;
+    char* saveImagePath = argc > 2 && strcmp(argv[1], "--save-image") == 0 ? argv[2] : NULL;
+    char* loadImagePath = argc > 2 && strcmp(argv[1], "--load-image") == 0 ? argv[2] : NULL;
+    char* paramsPath = argc > 2 && strcmp(argv[1], "--params") == 0 ? argv[2] : NULL;
+    char* jobsArg = isBatch && argc > 3 && strcmp(argv[2], "--jobs") == 0 ? argv[3] :
+                    paramsPath != NULL && argc > 4 && strcmp(argv[3], "--jobs") == 0 ? argv[4] :
+                    isJobs ? argv[2] : NULL;
+    // every argument belongs to the mode, anything else is refused rather than ignored
+    int usedArgs = 1 + (isStream || isBatch) + (isJobs || saveImagePath || loadImagePath || paramsPath) * 2 +
+                   (jobsArg != NULL && !isJobs) * 2;
+    // 0 - all cores
+    int threadCount = jobsArg != NULL ? parseJobsArg(jobsArg) : 1;
+
+    if (usedArgs != argc || threadCount < 0) {
+        printUsage(name);
         return 1;
     }
-    else if (err == MALLOC_ERROR) {
-        printf("\n====== ERROR ======\n");
-        printf("Ends with malloc error\n");
-        freeCtxVarList(ctx.varList);
-        freeCtxMemRegList(ctx.memRegList);
-        freeStatementList(l);
-        return 2;
+    if (threadCount == 0) threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+    selectScanKernels();
+    selectLaneKernels();
+    initProgram(&prog);
+
+    if (loadImagePath != NULL) {
+        // source of the program is in the image
+        int err = loadImage(&prog, loadImagePath, &in);
+
+        if (err == SUCCESS) err = compileProgram(&prog);
+        if (err != SUCCESS) {
+            outPrintf("\n====== ERROR ======\n");
+            outPrintf(err == ERROR ? "Ends with image error\n" : "Ends with malloc error\n");
+            freeProgram(&prog);
+            return err;
+        }
+        status = runProgram(&prog, &in, isSandboxed);
+        freeProgram(&prog);
+        return status;
     }
 
-    printf("\n======= OUT =======\n\n");
-    for (node = l, lineCounter = 1; node; node = node->next, lineCounter++) {
-        int fChg = 0;
-        int err = interpretStatement(&fChg, &ctx, &node->st);
+    outPrintf("Enter linear C code:\n\n");
+
+    int err = inputOpen(&in, stdin, isStream || (isBatch && threadCount == 1));
+    if (err != SUCCESS) {
+        outPrintf("\n====== ERROR ======\n");
+        outPrintf(err == ERROR ? "Ends with input error\n" : "Ends with malloc error\n");
+        freeProgram(&prog);
+        return err;
+    }
 
-        if (err == MALLOC_ERROR) {
-            printf("Ends with malloc error\n");
-            freeCtxVarList(ctx.varList);
-            freeCtxMemRegList(ctx.memRegList);
-            freeStatementList(l);
-            return 2;
+    if (isBatch && threadCount > 1) {
+        err = runBatchParallel(&in, threadCount, isSandboxed);
+    }
+    else if (isStream || isBatch) {
+        err = ctxInit(&ctx, &prog, STREAM_MAX_VARS, isSandboxed);
+        if (err == SUCCESS) {
+            err = isStream ? runStream(&prog, &in, &ctx) : runBatch(&prog, &in, &ctx);
         }
-        
-        if (ctx.hasEvaluationError) {
-            printf("Error occurred in the line %d:\n", lineCounter);
-            printf("%s;\n", node->st.codeLine);
-            break;
+        freeContext(&ctx);
+    }
+    else {
+        err = threadCount > 1 ? parseParallel(&prog, &in, threadCount) : parse(&prog, &in);
+        if (err == SUCCESS) {
+            err = prepareProgram(&prog, saveImagePath == NULL);
         }
 
-        if (fChg) {
-            printf("%s;\n", node->st.codeLine);
+        if (err == SUCCESS && saveImagePath != NULL) {
+            if (saveImage(&prog, &in, saveImagePath) == SUCCESS) {
+                outPrintf("\nImage is saved to %s\n", saveImagePath);
+            }
+            else {
+                outPrintf("\n====== ERROR ======\n");
+                outPrintf("Ends with image error\n");
+                status = 1;
+            }
+        }
+        else if (err == SUCCESS && paramsPath != NULL) {
+            status = runParams(&prog, &in, paramsPath, threadCount, isSandboxed);
+        }
+        else if (err == SUCCESS) {
+            status = runProgram(&prog, &in, isSandboxed);
         }
     }
 
-    if (!ctx.hasEvaluationError) {
-        printf("\n===== SUCCESS =====\n");
+    if (err == ERROR) {
+        printParsingError(&in, &prog);
+        status = 1;
+    }
+    else if (err == MALLOC_ERROR) {
+        outPrintf("\n====== ERROR ======\n");
+        outPrintf("Ends with malloc error\n");
+        status = 2;
     }
 
-    freeCtxVarList(ctx.varList);
-    freeCtxMemRegList(ctx.memRegList);
-    freeStatementList(l);
-    return 0;
+    inputClose(&in);
+    freeProgram(&prog);
+    return status;
 }